@@ -0,0 +1,47 @@
+// Region based bump allocator for AST nodes
+
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+typedef struct region {
+    struct region *next;
+    size_t count;       // used words
+    size_t capacity;    // total words
+    uintptr_t data[];
+} Region;
+
+typedef struct {
+    Region *begin;
+    Region *end;
+} Arena;
+
+// Position in the arena, everything allocated after it can be dropped
+typedef struct {
+    Region *end;
+    size_t count;
+} Arena_Mark;
+
+#define REGION_DEFAULT_CAPACITY (8 * 1024)
+
+// Usage:
+//  Arena arena = {0};
+//  Ast_Node *node = arena_alloc(&arena, sizeof(Ast_Node));
+//  arena_reset(&arena); // all memory can be reused, nothing goes back to the system
+//  arena_free(&arena);  // release all regions
+//
+//  Arena_Mark mark = arena_mark(&arena);
+//  ...
+//  arena_rewind(&arena, mark);    // drop allocations made after the mark
+
+void *arena_alloc(Arena *a, size_t size_bytes);
+Arena_Mark arena_mark(Arena *a);
+void arena_rewind(Arena *a, Arena_Mark mark);
+void arena_reset(Arena *a);
+void arena_free(Arena *a);
+
+#endif // ARENA_H_
@@ -0,0 +1,40 @@
+// Vectorized evaluation of one program over columns of variable values
+
+#ifndef BATCH_H_
+#define BATCH_H_
+
+#include "./bytecode.h"
+
+// Rows are evaluated in blocks, every stack slot holds one block
+#define BATCH_BLOCK 256
+
+// `data` points to array of i64_t if type is VAL_INT, otherwise array of double
+typedef struct {
+    Value_Type type;
+    const void *data;
+} Column;
+
+// Blocks of stack slots, kept by the caller between calls. Grows to the
+// deepest program it was given. Every thread needs its own
+typedef struct {
+    char *mem;
+    size_t depth;
+} Batch_Scratch;
+
+// Usage:
+//  Column cols[vl.count];      // column for each variable, indexed as in Var_List
+//  cols[var_find(&vl, name)] = (Column) { .type = VAL_INT, .data = xs };
+//
+//  Batch_Scratch scratch = {0};
+//  i64_t out[rows];            // room for `rows` 8 byte values
+//  Value_Type type = bc_eval_batch(&prog, cols, rows, out, &scratch);
+//  batch_clean(&scratch);
+//
+// Only columns of variables referenced by program are read. Result for
+// row `i` is written to `out[i]`, returned type tells how to read it.
+// Empty program writes nothing and returns VAL_INT.
+// i64 and f64 operations use SSE2 or AVX2, chosen at runtime
+Value_Type bc_eval_batch(const Program *prog, const Column *cols, size_t rows, void *out, Batch_Scratch *scratch);
+void batch_clean(Batch_Scratch *scratch);
+
+#endif // BATCH_H_
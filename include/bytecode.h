@@ -0,0 +1,75 @@
+// Stack machine bytecode compiled from Ast
+
+#ifndef BYTECODE_H_
+#define BYTECODE_H_
+
+#include "./parser.h"
+
+typedef enum {
+    OP_PUSH = 0,    // push consts[arg]
+    OP_LOAD,        // push value of variable vl->items[arg]
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_HALT,
+    OP_COUNT
+} Opcode;
+
+typedef struct {
+    uint32_t op;
+    uint32_t arg;
+} Inst;
+
+typedef struct {
+    Inst *items;
+    size_t count;
+    size_t capacity;
+    Value *consts;
+    size_t consts_count;
+    size_t consts_capacity;
+    size_t max_stack;   // size of stack needed by `bc_eval`
+} Program;
+
+// Type of a variable seen at compile time, code specialized by types
+// is valid only while it holds
+typedef struct {
+    uint32_t var;
+    Value_Type type;
+} Type_Guard;
+
+typedef struct {
+    Type_Guard *items;
+    size_t count;
+    size_t capacity;
+} Type_Guards;
+
+// Guard for variable is added once
+void guard_add(Type_Guards *guards, uint32_t var, Value_Type type);
+// 1 if every guarded variable still has its type
+int guard_check(const Type_Guards *guards, const Var_List *vl);
+
+// Usage:
+//  parser(&ast, &lex);
+//  Program prog = {0};
+//  bc_compile(&prog, &ast);      // before `eval`, because `eval` folds the tree
+//
+//  Value stack[prog.max_stack];
+//  Value res = bc_eval(&prog, &vl, stack); // as many times as needed,
+//                                          // variables are read on each call
+//  bc_clean(&prog);
+
+void bc_clean(Program *prog);
+void bc_compile(Program *prog, Ast *ast);
+void print_program(Program *prog);
+
+// For threaded interpreters: their handlers end with the same dispatch,
+// and without this GCC merges them into one shared indirect jump, which
+// the branch predictor can not tell apart
+#define BC_DISPATCH_FN __attribute__((optimize("no-crossjumping")))
+
+// Program is not changed and nothing is allocated, so
+// the same program can be evaluated from several threads
+Value bc_eval(const Program *prog, const Var_List *vl, Value *stack);
+
+#endif // BYTECODE_H_
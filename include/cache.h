@@ -0,0 +1,71 @@
+// Bounded cache of compiled expressions keyed by their source
+
+#ifndef CACHE_H_
+#define CACHE_H_
+
+#include "./bytecode.h"
+
+#define CACHE_DEFAULT_CAPACITY 1024
+
+typedef struct {
+    uint32_t *items;
+    size_t count;
+    size_t capacity;
+} Cache_Vars;
+
+// `text` is normalized source, it is owned by the entry and reused
+// together with `prog` when the entry is evicted
+typedef struct {
+    char *text;
+    size_t text_count;
+    size_t text_capacity;
+    uint64_t hash;
+
+    Program prog;
+    Cache_Vars vars;    // variables read by `prog`, every one only once
+
+    Value val;
+    uint64_t stamp;     // `tick` of Var_List when `val` was computed
+    int has_val;
+    int ref;            // second chance bit for CLOCK
+} Cache_Entry;
+
+// Entries are replaced by CLOCK: hand clears `ref` of recently used
+// entries and evicts the first one which was not used since last pass.
+// `index` is open addressing table (linear probing) of entry index + 1
+typedef struct {
+    Cache_Entry *entries;
+    size_t count;
+    size_t capacity;        // set before first use, CACHE_DEFAULT_CAPACITY if 0
+    size_t hand;
+    uint32_t *index;
+    size_t index_capacity;  // always power of two
+
+    Ast ast;                // scratch for compiling misses
+    Value_Stack stack;      // scratch for `bc_eval`
+    String_View key;        // scratch for normalized source
+    size_t key_capacity;
+
+    size_t hits;            // source was found, lexer and parser skipped
+    size_t misses;          // source was lexed, parsed and compiled
+    size_t value_hits;      // hit where cached value was still valid
+    size_t evictions;
+} Cache;
+
+// Usage:
+//  Cache cache = {0};
+//  Value res = cache_eval(&cache, sv_from_cstr("base + 4 * idx"), &vl);
+//  ...
+//  printf("%zu hits, %zu misses\n", cache.hits, cache.misses);
+//  cache_clean(&cache);
+//
+// Source is normalized before lookup: whitespace runs become one space,
+// and are dropped at ends and around operators and brackets, so
+// "base+4*idx" and " base + 4 * idx" share an entry.
+// Compiled programs read variables by index, so one cache must always be
+// used with the same Var_List
+const Program *cache_compile(Cache *cache, String_View src, Var_List *vl);
+Value cache_eval(Cache *cache, String_View src, Var_List *vl);
+void cache_clean(Cache *cache);
+
+#endif // CACHE_H_
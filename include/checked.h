@@ -0,0 +1,59 @@
+// Bytecode evaluation with overflow checked integer arithmetic
+
+#ifndef CHECKED_H_
+#define CHECKED_H_
+
+#include "./bytecode.h"
+
+// What happens when i64 result of `+ - * /` does not fit
+typedef enum {
+    ARITH_WRAP = 0,     // two's complement, same results as `bc_eval`
+    ARITH_TRAP,         // evaluation stops with ARITH_OVERFLOW
+    ARITH_SATURATE,     // result is clamped to INT64_MIN or INT64_MAX
+    ARITH_PROMOTE,      // whole program is run again on 128 bit integers
+    ARITH_POLICY_COUNT
+} Arith_Policy;
+
+typedef enum {
+    ARITH_OK = 0,
+    ARITH_OVERFLOW,     // result does not fit, by TRAP or PROMOTE
+    ARITH_DIV_ZERO,     // integer division by zero, with every policy
+    ARITH_STATUS_COUNT
+} Arith_Status;
+
+const char *arith_policy_name(Arith_Policy policy);
+const char *arith_status_name(Arith_Status status);
+
+// Result of i64 `a op b` for the case the fast path gave up on: overflow
+// or division by zero. WRAP and SATURATE make the result, TRAP does not.
+// PROMOTE is not handled here, it is up to the evaluator
+Arith_Status arith_slow(Opcode op, i64_t a, i64_t b, Arith_Policy policy, i64_t *dst);
+
+// Program is run one operation at a time, int ones through `arith_slow`
+// with `policy`, which must not be PROMOTE. Returns index of the
+// instruction which failed, or of OP_HALT if none did, then the result
+// is in `stack[0]`. It is the cold path of `bc_eval_checked`, and tells
+// where its error is
+size_t bc_eval_slow(const Program *prog, const Var_List *vl, Value *stack,
+                    Arith_Policy policy, Arith_Status *status);
+
+// Usage:
+//  Value stack[prog.max_stack];
+//  Arith_Status status;
+//  Value res = bc_eval_checked(&prog, &vl, stack, ARITH_TRAP, &status);
+//  if (status != ARITH_OK) printf("%s\n", arith_status_name(status));
+//
+// Same as `bc_eval`, but every integer operation is checked by
+// `__builtin_*_overflow`, which is one never taken `jo` on the fast path.
+// WRAP goes on with the wrapped result, other policies run the program
+// again by `bc_eval_slow`, or on 128 bit integers with PROMOTE, and so
+// does division by zero. Result is
+// VALUE_INT(0) if status is not ARITH_OK. Float and mixed operations
+// follow VALUE_BINARY_OP.
+// With PROMOTE intermediate results can be as wide as 128 bits, result
+// is ARITH_OK if the final one fits i64 again, as in `a * b / c`.
+// The wide run allocates its own stack, nothing else is allocated
+Value bc_eval_checked(const Program *prog, const Var_List *vl, Value *stack,
+                      Arith_Policy policy, Arith_Status *status);
+
+#endif // CHECKED_H_
@@ -0,0 +1,60 @@
+// Hash-consed expression DAG: structurally equal subtrees share one node
+
+#ifndef DAG_H_
+#define DAG_H_
+
+#include "./parser.h"
+#include "./flat.h"
+
+// Epoch of nodes which never have to be computed again
+#define DAG_FOREVER UINT64_MAX
+
+// Nodes use the same ops and layout as Flat_Ast, children always have
+// smaller ids than parents. Node is looked up by (op, value, left, right)
+// before it is made, so one node stands for every equal subtree of every
+// expression added to the table. `index` is open addressing table
+// (linear probing) of node id + 1.
+// `vals` of operator and variable nodes is valid only if `epochs` of the
+// node equals `epoch`. Epoch advances when variables are pushed (Var_List
+// tick changes) or by `dag_next_epoch`, so inside one epoch every node is
+// evaluated at most once, however many expressions share it. Nodes which
+// do not depend on variables are computed once for the life of the dag
+typedef struct {
+    uint8_t *ops;
+    Value *vals;
+    uint32_t *left;
+    uint32_t *right;
+    uint64_t *epochs;
+    uint8_t *varying;       // node depends on some variable
+    size_t count;
+    size_t capacity;
+
+    uint32_t *index;
+    size_t index_capacity;  // always power of two
+
+    Var_List *vl;
+    uint64_t epoch;
+    uint64_t tick;          // Var_List tick seen at start of `epoch`
+
+    size_t requested;       // nodes asked from `dag_node`, shared or not
+    size_t evaluated;       // nodes computed by `dag_eval`
+
+    Index_Stack stack;      // scratch for `dag_add` and `dag_eval`
+} Dag;
+
+// Usage:
+//  Dag dag = {0};
+//  parser(&ast, &lex);
+//  uint32_t root = dag_add(&dag, &ast);   // ast can be reset after it
+//  ...
+//  Value res = dag_eval(&dag, root);
+//  dag_clean(&dag);
+//
+// All expressions of one dag must be lexed with the same Var_List
+uint32_t dag_node(Dag *dag, Flat_Op op, Value val, uint32_t left, uint32_t right);
+uint32_t dag_add(Dag *dag, Ast *ast);
+Value dag_eval(Dag *dag, uint32_t root);
+void dag_next_epoch(Dag *dag);
+void dag_clean(Dag *dag);
+
+#endif // DAG_H_
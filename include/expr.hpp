@@ -0,0 +1,352 @@
+// Compile-time front end: grammar and int/float rules of lexer.c and parser.c
+// as constexpr C++17, plus evaluator types specialized per expression (C++20)
+
+#ifndef EXPR_HPP_
+#define EXPR_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+namespace expr {
+
+// Same order as Value_Type
+enum class Type : uint8_t { Float = 0, Int };
+
+// Bits of the union in Value
+struct Value {
+    Type type = Type::Int;
+    uint64_t bits = 0;
+
+    static constexpr Value from_int(long long x) { return { Type::Int, (uint64_t) x }; }
+    static constexpr Value from_float(double x) { return { Type::Float, __builtin_bit_cast(uint64_t, x) }; }
+
+    constexpr long long i64() const { return (long long) bits; }
+    constexpr double f64() const { return __builtin_bit_cast(double, bits); }
+    constexpr double as_f64() const { return type == Type::Float ? f64() : (double) i64(); }
+};
+
+// Thrown at runtime, during constant evaluation it is a compile error
+struct Error : std::runtime_error {
+    size_t pos;     // offset in the source
+    Error(const char *message, size_t pos) : std::runtime_error(message), pos(pos) {}
+};
+
+struct Binding {
+    std::string_view name;
+    Value val;
+};
+
+enum class Op : uint8_t { Push, Load, Add, Sub, Mul, Div };
+
+struct Inst {
+    Op op = Op::Push;
+    uint32_t arg = 0;   // Load: index into `names` of program
+    Value val = {};     // Push
+    size_t sp = 0;      // stack depth before the instruction
+};
+
+// Int with int gives int, otherwise int operand is converted, as
+// VALUE_BINARY_OP does
+template <Op op>
+constexpr Value binary(Value a, Value b)
+{
+    if (a.type == Type::Float || b.type == Type::Float) {
+        double x = a.as_f64(), y = b.as_f64();
+        if constexpr (op == Op::Add) return Value::from_float(x + y);
+        if constexpr (op == Op::Sub) return Value::from_float(x - y);
+        if constexpr (op == Op::Mul) return Value::from_float(x * y);
+        if constexpr (op == Op::Div) return Value::from_float(x / y);
+    } else {
+        long long x = a.i64(), y = b.i64();
+        if constexpr (op == Op::Add) return Value::from_int(x + y);
+        if constexpr (op == Op::Sub) return Value::from_int(x - y);
+        if constexpr (op == Op::Mul) return Value::from_int(x * y);
+        if constexpr (op == Op::Div) return Value::from_int(x / y);
+    }
+}
+
+constexpr Value binary(Op op, Value a, Value b)
+{
+    switch (op) {
+        case Op::Add: return binary<Op::Add>(a, b);
+        case Op::Sub: return binary<Op::Sub>(a, b);
+        case Op::Mul: return binary<Op::Mul>(a, b);
+        case Op::Div: return binary<Op::Div>(a, b);
+        default: throw Error("unknown operator", 0);
+    }
+}
+
+// Classes of sv_class
+constexpr bool is_space(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+constexpr bool is_digit(char c) { return c >= '0' && c <= '9'; }
+constexpr bool is_alpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+constexpr bool is_value(char c) { return is_digit(c) || c == '.'; }
+
+// Precedence of op_prec, 0 for `%`, which is lexed but not parsed
+constexpr int prec(char op)
+{
+    switch (op) {
+        case '+': case '-': return 1;
+        case '*': case '/': return 2;
+        default: return 0;
+    }
+}
+
+constexpr Op to_op(char op)
+{
+    switch (op) {
+        case '+': return Op::Add;
+        case '-': return Op::Sub;
+        case '*': return Op::Mul;
+        default: return Op::Div;
+    }
+}
+
+// Same literals as number_parse_i64 and the exact path of number_parse_f64.
+// Floats which number.c passes to strtod are rejected, as the result would
+// have to be rounded by hand
+constexpr Value parse_number(std::string_view sv, size_t pos)
+{
+    uint64_t m = 0;
+    bool overflow = false;
+    size_t frac = 0;
+    bool is_float = false;
+
+    for (size_t i = 0; i < sv.size(); ++i) {
+        if (sv[i] == '.') {
+            if (is_float) throw Error("cannot parse number", pos);
+            is_float = true;
+            continue;
+        }
+        uint64_t d = (uint64_t) (sv[i] - '0');
+        if (m > (UINT64_MAX - d) / 10) overflow = true;
+        m = m * 10 + d;
+        if (is_float) frac += 1;
+    }
+
+    if (!is_float) {
+        if (overflow || m > (uint64_t) INT64_MAX) throw Error("cannot parse number to int64", pos);
+        return Value::from_int((long long) m);
+    }
+
+    if (overflow || m > (1ULL << 53) || frac > 22) throw Error("float literal is too long for constexpr", pos);
+    double p = 1.0;
+    for (size_t i = 0; i < frac; ++i) p *= 10.0;   // exact up to 1e22
+    return Value::from_float((double) m / p);
+}
+
+// RPN of the expression, as walked by bc_compile. N bounds the count of
+// tokens, so every stack of the parser fits into arrays of N
+template <size_t N>
+struct Program {
+    Inst items[N] = {};
+    size_t count = 0;
+    size_t max_stack = 0;
+
+    // Variables in order of first use, `Load` refers to them by index
+    std::string_view names[N] = {};
+    size_t var_count = 0;
+
+    constexpr Value eval(const Value *vars) const
+    {
+        Value stack[N] = {};
+        for (size_t i = 0; i < count; ++i) {
+            const Inst &inst = items[i];
+            switch (inst.op) {
+                case Op::Push: stack[inst.sp] = inst.val; break;
+                case Op::Load: stack[inst.sp] = vars[inst.arg]; break;
+                default: stack[inst.sp - 2] = binary(inst.op, stack[inst.sp - 2], stack[inst.sp - 1]);
+            }
+        }
+        return stack[0];
+    }
+
+    // Values are matched to `names` by name
+    template <size_t K>
+    constexpr Value eval(const Binding (&bindings)[K]) const
+    {
+        Value vars[N] = {};
+        for (size_t i = 0; i < var_count; ++i) {
+            size_t j = 0;
+            while (j < K && bindings[j].name != names[i]) j++;
+            if (j == K) throw Error("unknown variable", 0);
+            vars[i] = bindings[j].val;
+        }
+        return eval(vars);
+    }
+
+    constexpr Value eval() const
+    {
+        if (var_count > 0) throw Error("expression has variables", 0);
+        return eval(static_cast<const Value *>(nullptr));
+    }
+
+    constexpr void emit(Inst inst)
+    {
+        size_t sp = 0;
+        if (count > 0) sp = items[count - 1].sp + (items[count - 1].op <= Op::Load ? 1 : -1);
+        inst.sp = sp;
+        items[count++] = inst;
+        if (sp + 1 > max_stack) max_stack = sp + 1;
+    }
+
+    constexpr uint32_t var(std::string_view name)
+    {
+        for (size_t i = 0; i < var_count; ++i) {
+            if (names[i] == name) return (uint32_t) i;
+        }
+        names[var_count] = name;
+        return (uint32_t) var_count++;
+    }
+};
+
+// Shunting-yard as in `parser`, tokens are scanned as in `lex_scan`
+template <size_t N>
+constexpr Program<N> compile(std::string_view src)
+{
+    Program<N> prog;
+    char ops[N] = {};   // operators and '('
+    size_t op_count = 0;
+
+    bool expect_operand = true;
+    size_t i = 0;
+    while (true) {
+        while (i < src.size() && is_space(src[i])) i++;
+        if (i == src.size()) break;
+
+        size_t pos = i;
+        char c = src[i];
+
+        if (expect_operand) {
+            if (is_digit(c)) {
+                while (i < src.size() && is_value(src[i])) i++;
+                prog.emit({ Op::Push, 0, parse_number(src.substr(pos, i - pos), pos) });
+                expect_operand = false;
+            } else if (is_alpha(c)) {
+                while (i < src.size() && is_alpha(src[i])) i++;
+                prog.emit({ Op::Load, prog.var(src.substr(pos, i - pos)) });
+                expect_operand = false;
+            } else if (c == '(') {
+                ops[op_count++] = c;
+                i++;
+            } else {
+                throw Error("expected value or `(`", pos);
+            }
+            continue;
+        }
+
+        if (prec(c) > 0) {
+            // All operators are left associative
+            while (op_count > 0 && ops[op_count - 1] != '(' && prec(ops[op_count - 1]) >= prec(c)) {
+                prog.emit({ to_op(ops[--op_count]) });
+            }
+            ops[op_count++] = c;
+            expect_operand = true;
+            i++;
+        } else if (c == ')') {
+            while (op_count > 0 && ops[op_count - 1] != '(') prog.emit({ to_op(ops[--op_count]) });
+            if (op_count == 0) throw Error("unexpected `)`", pos);
+            op_count--;
+            i++;
+        } else {
+            throw Error("expected operator or `)`", pos);
+        }
+    }
+
+    if (expect_operand) throw Error("unexpected end of expression", src.size());
+    while (op_count > 0) {
+        if (ops[op_count - 1] == '(') throw Error("expected `)`", src.size());
+        prog.emit({ to_op(ops[--op_count]) });
+    }
+
+    return prog;
+}
+
+template <size_t N>
+constexpr Program<N> compile(const char (&src)[N])
+{
+    return compile<N>(std::string_view(src, N - 1));
+}
+
+// Usage:
+//  static_assert(expr::eval("2 * (3 + 4)").i64() == 14);
+//  constexpr expr::Value v = expr::eval("base + 4", {{ "base", expr::Value::from_int(16) }});
+template <size_t N>
+constexpr Value eval(const char (&src)[N])
+{
+    return compile(src).eval();
+}
+
+template <size_t N, size_t K>
+constexpr Value eval(const char (&src)[N], const Binding (&bindings)[K])
+{
+    return compile(src).eval(bindings);
+}
+
+#if __cplusplus >= 202002L
+
+template <size_t N>
+struct Fixed_String {
+    char data[N] = {};
+    constexpr Fixed_String(const char (&src)[N])
+    {
+        for (size_t i = 0; i < N; ++i) data[i] = src[i];
+    }
+};
+
+// Evaluator type of one expression: program is built by the compiler and
+// unrolled into straight code, where every stack slot has a constant index.
+// Variable values are given in order of first use in the source.
+// Usage:
+//  using Offset = expr::Expr<"base + 4 * n">;
+//  expr::Value v = Offset::eval(base, n);
+template <Fixed_String S>
+struct Expr {
+    static constexpr Program<sizeof(S.data)> prog = compile(S.data);
+    static constexpr size_t var_count = prog.var_count;
+
+    template <typename... Vals>
+        requires (sizeof...(Vals) == prog.var_count)
+    static constexpr Value eval(Vals... vals)
+    {
+        const Value vars[sizeof...(Vals) + 1] = { vals... };
+        return run(vars, std::make_index_sequence<prog.count>());
+    }
+
+    static constexpr Value value() requires (prog.var_count == 0)
+    {
+        constexpr Value v = eval();
+        return v;
+    }
+
+private:
+    template <size_t I>
+    static constexpr void step(Value *stack, const Value *vars)
+    {
+        constexpr Inst inst = prog.items[I];
+        if constexpr (inst.op == Op::Push) {
+            stack[inst.sp] = inst.val;
+        } else if constexpr (inst.op == Op::Load) {
+            stack[inst.sp] = vars[inst.arg];
+        } else {
+            stack[inst.sp - 2] = binary<inst.op>(stack[inst.sp - 2], stack[inst.sp - 1]);
+        }
+    }
+
+    template <size_t... I>
+    static constexpr Value run(const Value *vars, std::index_sequence<I...>)
+    {
+        Value stack[prog.max_stack] = {};
+        (step<I>(stack, vars), ...);
+        return stack[0];
+    }
+};
+
+#endif // __cplusplus >= 202002L
+
+} // namespace expr
+
+#endif // EXPR_HPP_
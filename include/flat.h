@@ -0,0 +1,49 @@
+// Flat AST: nodes stored contiguously in post-order (struct of arrays)
+
+#ifndef FLAT_H_
+#define FLAT_H_
+
+#include "./parser.h"
+
+typedef enum {
+    FLAT_VALUE = 0,
+    FLAT_VAR,           // `left` is index into Var_List
+    FLAT_ADD,
+    FLAT_SUB,
+    FLAT_MUL,
+    FLAT_DIV
+} Flat_Op;
+
+typedef struct {
+    uint32_t *items;
+    size_t count;
+    size_t capacity;
+} Index_Stack;
+
+// Children always precede their parent, so last node is the root.
+// For operator and variable nodes `vals` slot is a scratch for result of
+// `flat_eval`, constants are never overwritten, so tree can be evaluated many times
+typedef struct {
+    uint8_t *ops;
+    Value *vals;
+    uint32_t *left;
+    uint32_t *right;
+    size_t count;
+    size_t capacity;
+    Var_List *vl;
+
+    // Operand stack of `flat_compile`, kept between expressions
+    Index_Stack stack;
+} Flat_Ast;
+
+void print_flat(Flat_Ast *fa);
+void flat_clean(Flat_Ast *fa);
+
+// Flattens tree made by `parser` or `parser_try`, so errors of the
+// expression are reported by them. Tree must not be folded by `eval` yet
+void flat_compile(Flat_Ast *fa, Ast *ast);
+
+uint32_t flat_push(Flat_Ast *fa, Flat_Op op, Value val, uint32_t left, uint32_t right);
+Value flat_eval(Flat_Ast *fa);
+
+#endif // FLAT_H_
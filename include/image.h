@@ -0,0 +1,186 @@
+// Binary image of compiled expressions, used straight from mmap
+
+#ifndef IMAGE_H_
+#define IMAGE_H_
+
+#include "./bytecode.h"
+
+#define IMAGE_MAGIC "SASTIMG"       // 8 bytes with '\0'
+#define IMAGE_VERSION 1
+#define IMAGE_ENDIAN 0x01020304u    // reads differently on other byte order
+#define IMAGE_NOT_FOUND ((size_t) -1)
+#define IMAGE_UNBOUND UINT32_MAX
+
+#define IMAGE_CHECK_NONE 0
+#define IMAGE_CHECK_OK   1
+#define IMAGE_CHECK_BAD  2
+
+// File layout: header, then sections in order of the header fields, each
+// aligned to 8 bytes. Every reference is an index or an offset from the
+// start of its section, so the file is valid at any address
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t endian;
+    uint64_t file_size;
+
+    uint64_t expr_count;
+    uint64_t sym_count;
+    uint64_t inst_count;
+    uint64_t const_count;
+    uint64_t text_size;
+    uint64_t index_capacity;    // power of two
+
+    // Offsets of sections from the start of file
+    uint64_t exprs;
+    uint64_t syms;
+    uint64_t insts;
+    uint64_t consts;
+    uint64_t text;
+    uint64_t index;
+} Image_Header;
+
+// Program of bytecode.h: PUSH refers to constants of the expression,
+// LOAD refers to symbol of the image instead of Var_List index
+typedef struct {
+    uint64_t hash;          // sv_hash of normalized source
+    uint32_t text;          // normalized source in text section
+    uint32_t text_count;
+    uint32_t inst;          // first instruction, last one is OP_HALT
+    uint32_t inst_count;
+    uint32_t consts;        // first constant
+    uint32_t const_count;
+    uint32_t max_stack;
+    uint32_t reserved;
+} Image_Expr;
+
+// Variables are stored by name, found in Var_List by `image_bind`
+typedef struct {
+    uint64_t hash;          // sv_hash of name, as in Variable
+    uint32_t name;          // name in text section
+    uint32_t name_count;
+} Image_Symbol;
+
+// Value with fixed layout
+typedef struct {
+    uint32_t type;          // Value_Type
+    uint32_t reserved;
+    uint64_t bits;
+} Image_Value;
+
+typedef struct {
+    Image_Expr *items;
+    size_t count;
+    size_t capacity;
+} Image_Exprs;
+
+typedef struct {
+    Image_Symbol *items;
+    size_t count;
+    size_t capacity;
+} Image_Symbols;
+
+typedef struct {
+    Inst *items;
+    size_t count;
+    size_t capacity;
+} Image_Insts;
+
+typedef struct {
+    Image_Value *items;
+    size_t count;
+    size_t capacity;
+} Image_Values;
+
+typedef struct {
+    char *items;
+    size_t count;
+    size_t capacity;
+} Image_Text;
+
+typedef struct {
+    uint32_t *items;
+    size_t count;
+    size_t capacity;
+} Image_Slots;
+
+// Sections are built in memory and written by `image_save`
+typedef struct {
+    Image_Exprs exprs;
+    Image_Symbols syms;
+    Image_Insts insts;
+    Image_Values consts;
+    Image_Text text;
+
+    uint32_t *index;        // open addressing table of expr id + 1
+    size_t index_capacity;
+
+    Image_Slots sym_of_var; // symbol id + 1 of Var_List index, 0 if none yet
+    Ast ast;                // scratch for compiling
+    Program prog;
+    Var_List *vl;
+} Image_Writer;
+
+typedef struct {
+    void *data;             // mapping of the whole file
+    size_t size;
+
+    const Image_Header *header;
+    const Image_Expr *exprs;
+    const Image_Symbol *syms;
+    const Inst *insts;
+    const Image_Value *consts;
+    const char *text;
+    const uint32_t *index;
+
+    Image_Slots slots;      // Var_List index of every symbol, set by `image_bind`
+    uint8_t *checks;        // IMAGE_CHECK_* of every expression, reset by `image_bind`
+    Program *progs;         // program of every expression which passed the check
+    Arena code;             // instructions and constants of `progs`
+    String_View key;        // scratch for normalized source
+    size_t key_capacity;
+} Image;
+
+// Usage:
+//  Image_Writer w = {0};
+//  image_add(&w, sv_from_cstr("base + 4 * idx"), &vl);
+//  image_save(&w, "exprs.img");
+//  image_writer_clean(&w);
+//
+//  Image img = {0};
+//  if (image_load(&img, "exprs.img")) {
+//      image_bind(&img, &vl);
+//      size_t id = image_find(&img, sv_from_cstr("base+4*idx"));
+//      Value stack[img.exprs[id].max_stack];
+//      Value res = image_eval(&img, id, &vl, stack);
+//  }
+//  image_close(&img);
+//
+// Sources are normalized as in cache.h. Adding the same source again
+// returns its id. All expressions of one writer must be lexed with the
+// same Var_List
+size_t image_add(Image_Writer *w, String_View src, Var_List *vl);
+int image_save(const Image_Writer *w, const char *path);
+void image_writer_clean(Image_Writer *w);
+
+// Returns 0 if file is missing or is not an image of this version, then
+// expressions have to be compiled from source. Only the header and section
+// bounds are checked on load, expression is checked when it is found.
+// Nothing is copied from the file until then
+int image_load(Image *img, const char *path);
+
+// Returns number of symbols which are not in `vl`, expressions which
+// read them are not found, as are all of them before the first bind.
+// Variables pushed later need another bind, which also makes ids found
+// before it invalid
+size_t image_bind(Image *img, Var_List *vl);
+
+// Program of found expression is checked on the first find after a bind,
+// and its `max_stack` is at most its number of instructions. Then it is
+// copied out of the mapping once, with constants as Value and symbols as
+// Var_List indices, so `image_eval` is `bc_eval` of the copy
+size_t image_find(Image *img, String_View src);
+Value image_eval(const Image *img, size_t id, const Var_List *vl, Value *stack);
+void image_close(Image *img);
+
+#endif // IMAGE_H_
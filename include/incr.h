@@ -0,0 +1,61 @@
+// Incremental evaluation: pushing a variable recomputes only what reads it
+
+#ifndef INCR_H_
+#define INCR_H_
+
+#include "./parser.h"
+#include "./flat.h"
+
+// `parent` of a root holds id of its expression with this bit set
+#define INCR_ROOT 0x80000000u
+
+// Nodes of all expressions use ops of Flat_Ast and are laid out in
+// post-order, so children always have smaller ids than parents and every
+// node keeps its last value in `vals`.
+// `deps` is the dependency index: for every Var_List entry, nodes which
+// read it. When variables change, their nodes and all ancestors up to
+// the root are marked dirty, and only dirty nodes are computed again
+typedef struct {
+    uint8_t *ops;
+    Value *vals;
+    uint32_t *left;
+    uint32_t *right;
+    uint32_t *parent;
+    uint8_t *dirty;
+    size_t count;
+    size_t capacity;
+
+    Index_Stack roots;      // root node of every expression
+    Index_Stack *deps;      // indexed by Var_List index
+    size_t deps_count;
+
+    Var_List *vl;
+    uint64_t tick;          // Var_List tick seen by the last update
+
+    Index_Stack changed;    // expressions whose value changed at the last update
+    Index_Stack queue;      // dirty nodes, scratch for `incr_update`
+    Index_Stack stack;      // scratch for `incr_add`
+
+    size_t recomputed;      // nodes computed again by all updates
+} Incr;
+
+// Usage:
+//  Incr inc = {0};
+//  parser(&ast, &lex);
+//  size_t id = incr_add(&inc, &ast);     // ast can be reset after it
+//  ...
+//  var_push(&vl, var_create("label", VALUE_INT(0x40)));
+//  const Index_Stack *changed = incr_update(&inc);
+//  for (size_t i = 0; i < changed->count; ++i) {
+//      Value v = incr_value(&inc, changed->items[i]);
+//  }
+//  incr_clean(&inc);
+//
+// Expressions are evaluated when added. All expressions must be lexed
+// with the same Var_List
+size_t incr_add(Incr *inc, Ast *ast);
+const Index_Stack *incr_update(Incr *inc);
+Value incr_value(const Incr *inc, size_t expr);
+void incr_clean(Incr *inc);
+
+#endif // INCR_H_
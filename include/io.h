@@ -0,0 +1,57 @@
+// Batch input straight from mmap and buffered output of results
+
+#ifndef IO_H_
+#define IO_H_
+
+#include "./checked.h"
+
+#define WRITER_DEFAULT_CAPACITY (1 << 20)
+
+// Longest "%lf" of a double is 309 digits of integer part, sign and ".000000"
+#define WRITER_VALUE_MAX 330
+
+// Bytes are collected in `items` and written to `fd` by one `write`
+// when the buffer is full, so output costs no syscall per result
+typedef struct {
+    char *items;
+    size_t count;
+    size_t capacity;    // set before first use, WRITER_DEFAULT_CAPACITY if 0,
+                        // smaller than WRITER_VALUE_MAX is raised to it
+    int fd;
+    int failed;         // some write failed, later output is dropped
+} Writer;
+
+// Whole file is mapped read only, `sv` points into the mapping.
+// Returns 0 if file can not be opened or mapped
+int io_map(const char *path, String_View *sv);
+void io_unmap(String_View sv);
+
+void writer_write(Writer *w, const char *data, size_t count);
+void writer_value(Writer *w, Value val);
+int writer_flush(Writer *w);
+void writer_clean(Writer *w);
+
+// Usage:
+//  String_View input;
+//  if (io_map("operands.txt", &input)) {
+//      Writer w = { .fd = STDOUT_FILENO };
+//      Ast ast = {0};
+//      size_t failed = 0;
+//      size_t n = io_eval(input, &vl, &ast, ARITH_WRAP, &w, &failed);   // one result per line
+//      writer_flush(&w);
+//      writer_clean(&w);
+//      ast_clean(&ast);
+//      io_unmap(input);
+//  }
+//
+// Expressions are separated by newlines or commas, empty ones are
+// skipped. Each one is lexed as String_View into the input, nothing is
+// copied, and is evaluated by `bc_eval_checked` with `policy`. A bad
+// expression does not stop the batch, neither does integer division by
+// zero or overflow under ARITH_TRAP: its line is `error: <pos>: <message>`
+// with offset in the expression and `failed` is incremented, if not NULL.
+// Returns number of evaluated expressions
+size_t io_eval(String_View input, Var_List *vl, Ast *ast, Arith_Policy policy,
+               Writer *w, size_t *failed);
+
+#endif // IO_H_
@@ -0,0 +1,42 @@
+// Native x86-64 code for hot expressions, bytecode interpreter elsewhere
+
+#ifndef JIT_H_
+#define JIT_H_
+
+#include "./bytecode.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+#   define JIT_X86_64
+#endif
+
+// Code reads variables straight from `items` of Var_List and returns bits
+// of the result, which has type `type`
+typedef uint64_t (*Jit_Func)(const Variable *vars);
+
+typedef struct {
+    Program prog;       // fallback, also used as input of code generator
+    Type_Guards guards;
+    Value_Type type;
+
+    Jit_Func func;      // NULL if native code was not made
+    size_t code_size;   // size of executable mapping
+} Jit;
+
+// Usage:
+//  Jit jit = {0};
+//  jit_compile(&jit, &ast);        // types of variables are taken now
+//
+//  Value stack[jit.prog.max_stack];
+//  Value res = jit_eval(&jit, &vl, stack);
+//  jit_clean(&jit);
+//
+// Types of values are known while compiling, so i64 lives in general
+// purpose registers and f64 in xmm registers. `stack` is used only when
+// code falls back to `bc_eval`: on other architectures, or if some
+// variable changed its type since `jit_compile`.
+// Returns 1 if native code was made
+int jit_compile(Jit *jit, Ast *ast);
+Value jit_eval(const Jit *jit, const Var_List *vl, Value *stack);
+void jit_clean(Jit *jit);
+
+#endif // JIT_H_
@@ -11,9 +11,36 @@
 
 #define EXIT exit(1)
 
+typedef enum {
+    EXPR_OK = 0,
+    EXPR_ERR_NUMBER,        // literal is malformed or does not fit
+    EXPR_ERR_CHAR,          // character which starts no token
+    EXPR_ERR_OPERATOR,      // operator which parser does not know
+    EXPR_ERR_VARIABLE,      // variable is not in Var_List
+    EXPR_ERR_SYNTAX,        // tokens in wrong order or unbalanced brackets
+    EXPR_STATUS_COUNT
+} Expr_Status;
+
+#define EXPR_ERROR_MESSAGE 128
+
+// Filled by the first error of `lexer_try`, `parser_try` or `expr_parse`.
+// `pos` is offset of the bad token in the source given to the lexer
+typedef struct {
+    Expr_Status status;
+    size_t pos;
+    char message[EXPR_ERROR_MESSAGE];
+} Expr_Error;
+
+// With `err` NULL message is printed and process exits, as functions
+// without `_try` do. Otherwise only the first error is kept
+__attribute__((format(printf, 4, 5)))
+void expr_error(Expr_Error *err, Expr_Status status, size_t pos, const char *fmt, ...);
+const char *expr_status_name(Expr_Status status);
+
 typedef enum {
     TYPE_OPERATOR = 0,
     TYPE_VALUE,
+    TYPE_VARIABLE,      // index into Var_List, value is read at eval
     TYPE_OPEN_BRACKET,
     TYPE_CLOSE_BRACKET,
     TYPE_NONE
@@ -21,18 +48,43 @@ typedef enum {
 
 typedef struct {
     Token_Type type;
+    uint32_t pos;       // offset in the source, fits into padding
     union 
     {
         Value val;
         char op;
+        size_t var;
     };
 } Token;
 
+#define TOKEN_IS_OPERAND(type) ((type) == TYPE_VALUE || (type) == TYPE_VARIABLE)
+
+// Precedence of binary operators, 0 if char is not a binary operator
+extern const uint8_t op_prec[256];
+
+typedef struct {
+    Token *items;
+    size_t count;
+    size_t capacity;
+} Token_Stack;
+
+// Count of tokens kept by stream lexer, parser can step back by one token
+#define LEX_RING 4
+
 typedef struct {
     Token *items;
     size_t count;
     size_t capacity;
     size_t tp;         // Token Pointer
+    Var_List *vl;      // variables which TYPE_VARIABLE tokens refer to
+    Expr_Error *err;   // NULL: errors exit the process
+    char *origin;      // start of the source, positions are counted from it
+
+    // Stream mode: tokens are scanned from `src` by `token_next`/`token_peek`
+    // and kept in `ring` instead of `items`, so nothing is allocated
+    int stream;
+    String_View src;
+    Token ring[LEX_RING];
 } Lexer;
 
 
@@ -46,5 +98,14 @@ Token_Type token_peek(Lexer *lex);
 
 Value tokenise_value(String_View sv);
 Lexer lexer(String_View src_sv, Var_List *vl);
+Lexer lexer_stream(String_View src_sv, Var_List *vl);
+
+// `err` is cleared, lexing stops at the first bad token and
+// `err->status` tells if it did.
+// Stream lexer reports errors when the parser reaches them. For both the
+// bad token looks like the end of input, so every consumer of the tokens
+// must check `err->status` when it is done
+Lexer lexer_try(String_View src_sv, Var_List *vl, Expr_Error *err);
+Lexer lexer_stream_try(String_View src_sv, Var_List *vl, Expr_Error *err);
 
 #endif // LEXER_H_
\ No newline at end of file
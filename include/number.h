@@ -0,0 +1,15 @@
+// Number literal parsing straight from String_View, nothing is allocated
+
+#ifndef NUMBER_H_
+#define NUMBER_H_
+
+#include "./sv.h"
+#include "./var.h"
+
+// Both return 0 if `sv` is not a valid literal or does not fit into result
+//  i64: DIGITS
+//  f64: DIGITS.DIGITS? (without exponent, as lexer cuts it)
+int number_parse_i64(String_View sv, i64_t *out);
+int number_parse_f64(String_View sv, double *out);
+
+#endif // NUMBER_H_
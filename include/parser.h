@@ -2,6 +2,7 @@
 #define PARSER_H_
 
 #include "./lexer.h"
+#include "./arena.h"
 
 typedef struct ast_node {
     Token token;
@@ -9,9 +10,32 @@ typedef struct ast_node {
     struct ast_node *right_operand; 
 } Ast_Node;
 
+typedef struct {
+    Ast_Node **items;
+    size_t count;
+    size_t capacity;
+} Node_Stack;
+
+typedef struct {
+    Value *items;
+    size_t count;
+    size_t capacity;
+} Value_Stack;
+
 typedef struct {
     Ast_Node *root;
     size_t count;
+    Arena arena;        // owns every node of the tree
+    Var_List *vl;       // taken from lexer, TYPE_VARIABLE nodes are resolved in it
+
+    // Parser stacks, kept between expressions to not allocate them again
+    Node_Stack nodes;
+    Token_Stack ops;
+
+    // Every node in post-order, filled by parser. All walks over the tree
+    // go through it or an explicit stack, so depth never touches the C stack
+    Node_Stack order;
+    Value_Stack values; // scratch for `ast_eval`
 } Ast;
 
 // This macro make need indent, when printing ast
@@ -26,23 +50,31 @@ void print_ast(Ast *ast);
 void print_node(Ast_Node *node);
 void print_ast_root(Ast_Node *node);
 
-#define BINARY_OP(dst, operator, op1, op2, type)                                        \
-    do {                                                                                \
-        if (type == 'f')                                                                \
-            (dst)->token.val.f64 = (op1)->token.val.f64 operator (op2)->token.val.f64;  \
-        else if (type == 'i')                                                           \
-            (dst)->token.val.i64 = (op1)->token.val.i64 operator (op2)->token.val.i64;  \
-    } while(0)              
-
 void eval(Ast *ast);
+Value ast_eval(Ast *ast);
 void parser(Ast *ast, Lexer *lex);
-void ast_clean(Ast_Node *node, size_t *node_count);
-void ast_push_subtree(Ast *ast, Ast_Node *subtree);
+
+// Usage:
+//  Expr_Error err = {0};
+//  Lexer lex = lexer_try(src, &vl, &err);
+//  if (parser_try(&ast, &lex, &err) != EXPR_OK) {
+//      printf("%s at %zu: %s\n", expr_status_name(err.status), err.pos, err.message);
+//  }
+//
+// Same as `parser`, but a bad expression returns its status instead of
+// exiting. Ast is left without root and can be used for the next one.
+// `err` must be the one given to the lexer
+Expr_Status parser_try(Ast *ast, Lexer *lex, Expr_Error *err);
+
+// Stream lexer and `parser_try` in one call
+Expr_Status expr_parse(Ast *ast, String_View src, Var_List *vl, Expr_Error *err);
+void ast_reset(Ast *ast);
+void ast_clean(Ast *ast);
 void subtree_node_count(Ast_Node *subtree, size_t *count);
 
-Ast_Node *ast_node_create(Token tk);
-Ast_Node *resolve_ast(Ast_Node *node);
-Ast_Node *parse_expr(Token tk, Lexer *lex);
-Ast_Node *parse_term(Token tk, Lexer *lex);
+Ast_Node *ast_node_create(Arena *arena, Token tk);
+Ast_Node *resolve_ast(const Var_List *vl, Ast_Node *node);
+void ast_post_order(Ast_Node *root, Node_Stack *order, Node_Stack *stack);
+Node_Stack *ast_order(Ast *ast);
 
 #endif // PARSER_H_
\ No newline at end of file
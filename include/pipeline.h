@@ -0,0 +1,23 @@
+// Evaluate many independent expressions on a pool of threads
+
+#ifndef PIPELINE_H_
+#define PIPELINE_H_
+
+#include "./parser.h"
+
+// Expressions are taken by workers in chunks of this size
+#define PIPELINE_CHUNK 64
+
+// Usage:
+//  String_View exprs[n];
+//  Value results[n];
+//  Expr_Status status[n];
+//  pipeline_eval(exprs, n, &vl, results, status, 0);  // 0 means one thread per core
+//
+// `results[i]` is answer for `exprs[i]` when `status[i]` is EXPR_OK, a bad
+// expression gets its error status and 0, and does not stop the others.
+// Var_List is shared by all workers and must not be changed until
+// `pipeline_eval` returns
+void pipeline_eval(String_View *exprs, size_t count, Var_List *vl, Value *results, Expr_Status *status, size_t threads);
+
+#endif // PIPELINE_H_
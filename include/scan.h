@@ -0,0 +1,27 @@
+// Character classification and SIMD scanning for String_View and lexer
+
+#ifndef SCAN_H_
+#define SCAN_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+    SV_SPACE   = 1 << 0,    // same set as isspace in "C" locale
+    SV_DIGIT   = 1 << 1,
+    SV_ALPHA   = 1 << 2,
+    SV_SPECIAL = 1 << 3,    // + - * / % ( )
+    SV_DOT     = 1 << 4
+} Sv_Class;
+
+extern const uint8_t sv_class[256];
+
+#define SV_IS(c, cls) (sv_class[(unsigned char) (c)] & (cls))
+
+// Length of the longest prefix of `s` of the class.
+// 16 (SSE2) or 32 (AVX2) bytes are checked at once, chosen at startup
+size_t sv_span_space(const char *s, size_t n);
+size_t sv_span_value(const char *s, size_t n);  // digits and '.'
+size_t sv_span_alpha(const char *s, size_t n);
+
+#endif // SCAN_H_
@@ -0,0 +1,74 @@
+// Opt-in counters and latency histograms, build with `make STATS=1`.
+// Without STATS_ENABLE every hook compiles to nothing and stats stay zero
+
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum {
+    STAT_TOKENS = 0,    // tokens produced by lexer in both modes
+    STAT_NODES,         // nodes made by `ast_node_create`
+    STAT_NODE_BYTES,    // bytes taken from arena by those nodes
+    STAT_DA_BYTES,      // bytes requested when `da_append` grows an array
+    STAT_VAR_LOOKUPS,   // probes of Var_List index
+    STAT_VAR_PROBES,    // slots visited by those probes
+    STAT_COUNT
+} Stat_Counter;
+
+typedef enum {
+    HIST_LEXER_NS = 0,  // wall time of `lexer` call
+    HIST_PARSER_NS,     // wall time of `parser` call, stream lexing included
+    HIST_EVAL_NS,       // wall time of `eval` and `ast_eval` calls
+    HIST_VAR_PROBE,     // slots visited by one Var_List probe
+    HIST_COUNT
+} Stat_Hist;
+
+// Bucket 0 counts zeros, bucket `b` counts values in [2^(b-1), 2^b)
+#define STATS_BUCKETS 65
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[STATS_BUCKETS];
+} Stats_Hist;
+
+typedef struct {
+    uint64_t counters[STAT_COUNT];
+    Stats_Hist hists[HIST_COUNT];
+} Stats;
+
+extern const char *stats_counter_names[STAT_COUNT];
+extern const char *stats_hist_names[HIST_COUNT];
+
+// Usage:
+//  Stats s;
+//  stats_get(&s);
+//  printf("%llu tokens\n", (unsigned long long) s.counters[STAT_TOKENS]);
+//  stats_dump_json(stdout);
+//  stats_reset();
+//
+// Updates are relaxed atomics, so threads of `pipeline_eval` can share stats
+void stats_get(Stats *out);
+void stats_reset(void);
+void stats_dump_json(FILE *f);
+
+uint64_t stats_now_ns(void);
+void stats_add(Stat_Counter counter, uint64_t n);
+void stats_hist_add(Stat_Hist hist, uint64_t value);
+
+#ifdef STATS_ENABLE
+#   define STATS_ADD(counter, n)    stats_add((counter), (n))
+#   define STATS_HIST(hist, value)  stats_hist_add((hist), (value))
+#   define STATS_TIME_BEGIN(t)      uint64_t t = stats_now_ns()
+#   define STATS_TIME_END(hist, t)  stats_hist_add((hist), stats_now_ns() - (t))
+#else
+#   define STATS_ADD(counter, n)    ((void) 0)
+#   define STATS_HIST(hist, value)  ((void) 0)
+#   define STATS_TIME_BEGIN(t)      ((void) 0)
+#   define STATS_TIME_END(hist, t)  ((void) 0)
+#endif
+
+#endif // STATS_H_
@@ -5,6 +5,9 @@
 
 #include <ctype.h>
 #include <string.h>
+#include <stdint.h>
+
+#include "./scan.h"
 
 typedef struct {
     char *data;
@@ -24,6 +27,8 @@ String_View sv_trim(String_View sv);
 String_View sv_div_by_delim(String_View *sv, char delim);
 
 int sv_cmp(String_View sv1, String_View sv2);
+uint64_t sv_hash(String_View sv);
+size_t sv_normalize(String_View src, char *out);
 int sv_to_int(String_View sv);
 int sv_is_float(String_View sv);
 int char_in_sv(String_View sv, char c);
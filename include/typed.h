@@ -0,0 +1,87 @@
+// Bytecode specialized by types inferred over the Ast
+
+#ifndef TYPED_H_
+#define TYPED_H_
+
+#include "./bytecode.h"
+#include "./flat.h"
+
+typedef enum {
+    TOP_PUSH = 0,   // push consts[arg]
+    TOP_LOAD,       // push variable vl->items[arg], its type is guarded
+    TOP_I2F,        // convert top of the stack from i64 to f64
+    TOP_I2F_NEXT,   // convert the slot under the top
+    TOP_ADD_I,
+    TOP_SUB_I,
+    TOP_MUL_I,
+    TOP_DIV_I,
+    TOP_ADD_F,
+    TOP_SUB_F,
+    TOP_MUL_F,
+    TOP_DIV_F,
+    TOP_HALT,
+    TOP_COUNT
+} Typed_Op;
+
+// Stack slot without a tag, its type is known from the program
+typedef union {
+    i64_t i64;
+    double f64;
+} Slot;
+
+typedef struct {
+    Value_Type *items;
+    size_t count;
+    size_t capacity;
+} Type_Stack;
+
+typedef struct {
+    uint32_t node;      // index in ast_order
+    uint32_t inst;      // instruction which pushed the operand
+} Typed_Operand;
+
+typedef struct {
+    Typed_Operand *items;
+    size_t count;
+    size_t capacity;
+} Typed_Operands;
+
+typedef struct {
+    Inst *items;
+    size_t count;
+    size_t capacity;
+    Value_Stack consts;     // types are already those of operations
+    size_t max_stack;
+    Value_Type type;        // of the result
+
+    Type_Guards guards;
+    Program prog;           // fallback if some guard fails
+
+    Type_Stack types;       // type of every node, filled by `ast_infer`
+    Typed_Operands operands; // scratch for `typed_compile`
+} Typed;
+
+// Type of every node of `ast_order(ast)` in the same order: literals by
+// their type, variables by their current value, operators are i64 only
+// if both operands are, as in VALUE_BINARY_OP. Returns type of the root
+Value_Type ast_infer(Ast *ast, Type_Stack *types);
+
+// Usage:
+//  Typed typed = {0};
+//  typed_compile(&typed, &ast);    // types of variables are taken now
+//
+//  Value stack[typed.max_stack];
+//  Value res = typed_eval(&typed, &vl, stack);
+//  typed_clean(&typed);
+//
+// Every operation has one type known at compile time, so evaluation
+// runs untagged slots with no type checks per node. An i64 operand of an
+// f64 operation gets explicit conversion, which is folded into literals.
+// If some variable changed its type since `typed_compile`, `bc_eval`
+// of `prog` is run instead, with the same results
+void typed_compile(Typed *typed, Ast *ast);
+Value typed_eval(const Typed *typed, const Var_List *vl, Value *stack);
+void print_typed(Typed *typed);
+void typed_clean(Typed *typed);
+
+#endif // TYPED_H_
@@ -8,6 +8,11 @@
 #   include "./sv.h"
 #endif
 
+#include "./arena.h"
+#include "./stats.h"
+
+// VALUE_BINARY_OP relies on these values: `&` of two types is VAL_INT
+// only if both are VAL_INT
 typedef enum {
     VAL_FLOAT = 0,
     VAL_INT
@@ -26,18 +31,51 @@ typedef struct {
 #define VALUE_INT(val) (Value) { .type = VAL_INT, .i64 = (val) }
 #define VALUE_FLOAT(val) (Value) { .type = VAL_FLOAT, .f64 = (val) }
 
+#define VALUE_AS_F64(v) ((v).type == VAL_FLOAT ? (v).f64 : (double) (v).i64)
+
+// Int with int gives int, anything else gives float and int operand
+// is converted, as C does. `dst` can be the same as `a`
+#define VALUE_BINARY_OP(dst, operator, a, b)                                \
+    do {                                                                    \
+        if (((a).type & (b).type) == VAL_INT) {                             \
+            (dst).i64 = (a).i64 operator (b).i64;                           \
+            (dst).type = VAL_INT;                                           \
+        } else {                                                            \
+            (dst).f64 = VALUE_AS_F64(a) operator VALUE_AS_F64(b);           \
+            (dst).type = VAL_FLOAT;                                         \
+        }                                                                   \
+    } while (0)
+
 // Variables can contain only numbers
 typedef struct {
     String_View name;
+    uint64_t hash;      // sv_hash(name)
     Value val;
+    uint64_t stamp;     // `tick` of the list when value was last pushed
 } Variable;
 
 #define VAR_NONE (Variable) { .name = sv_from_cstr("None") }
+#define VAR_NOT_FOUND ((size_t) -1)
+
+// Variables are stored in push order in `items`. `index` is an open
+// addressing hash table (linear probing) which holds item index + 1,
+// 0 means empty slot. Names are copied into `names` arena on push.
+// Every push advances `tick`, so results computed at some tick are
+// still valid while stamps of their variables are not newer. Push with
+// tick `t` keeps index of its variable in `log[t % VAR_LOG]`, so readers
+// which are at most VAR_LOG pushes behind find what changed without
+// looking at every variable
+#define VAR_LOG 64
 
 typedef struct {
     Variable *items;
     size_t capacity;
     size_t count;
+    uint32_t *index;
+    size_t index_capacity;  // always power of two
+    Arena names;
+    uint64_t tick;
+    uint32_t log[VAR_LOG];
 } Var_List;
 
 #define INIT_CAPACITY 256
@@ -49,6 +87,7 @@ typedef struct {
             (da)->capacity = (da)->capacity > 0 ? (da)->capacity * 2 : INIT_CAPACITY;   \
             (da)->items = realloc((da)->items, (da)->capacity * sizeof(*(da)->items));  \
             assert((da)->items != NULL);                                                \
+            STATS_ADD(STAT_DA_BYTES, (da)->capacity * sizeof(*(da)->items));            \
         }                                                                               \
         (da)->items[(da)->count++] = (new_item);                                        \
     } while(0)
@@ -64,6 +103,8 @@ typedef struct {
 void var_push(Var_List *vl, Variable var);
 void var_clean(Var_List *vl);
 Variable var_search(Var_List *vl, String_View name);
+size_t var_find(Var_List *vl, String_View name);
+size_t var_find_hash(Var_List *vl, String_View name, uint64_t hash);
 Variable var_create(char *name, Value val);
 
 #endif // VAR_H_
\ No newline at end of file
@@ -0,0 +1,84 @@
+#include "../include/arena.h"
+
+static Region *region_create(size_t capacity)
+{
+    Region *r = malloc(sizeof(Region) + sizeof(uintptr_t) * capacity);
+    assert(r != NULL);
+    r->next = NULL;
+    r->count = 0;
+    r->capacity = capacity;
+    return r;
+}
+
+void *arena_alloc(Arena *a, size_t size_bytes)
+{
+    size_t size = (size_bytes + sizeof(uintptr_t) - 1) / sizeof(uintptr_t);
+
+    if (a->end == NULL) {
+        assert(a->begin == NULL);
+        size_t capacity = REGION_DEFAULT_CAPACITY;
+        if (capacity < size) capacity = size;
+        a->end = region_create(capacity);
+        a->begin = a->end;
+    }
+
+    // After reset regions are reused in order before new one is created
+    while (a->end->count + size > a->end->capacity && a->end->next != NULL) {
+        a->end = a->end->next;
+    }
+
+    if (a->end->count + size > a->end->capacity) {
+        assert(a->end->next == NULL);
+        size_t capacity = REGION_DEFAULT_CAPACITY;
+        if (capacity < size) capacity = size;
+        a->end->next = region_create(capacity);
+        a->end = a->end->next;
+    }
+
+    void *result = &a->end->data[a->end->count];
+    a->end->count += size;
+    return result;
+}
+
+Arena_Mark arena_mark(Arena *a)
+{
+    return (Arena_Mark) {
+        .end = a->end,
+        .count = a->end != NULL ? a->end->count : 0,
+    };
+}
+
+// Regions after the marked one stay allocated and are reused as after reset
+void arena_rewind(Arena *a, Arena_Mark mark)
+{
+    if (mark.end == NULL) {
+        arena_reset(a);
+        return;
+    }
+
+    mark.end->count = mark.count;
+    for (Region *r = mark.end->next; r != NULL; r = r->next) {
+        r->count = 0;
+    }
+    a->end = mark.end;
+}
+
+void arena_reset(Arena *a)
+{
+    for (Region *r = a->begin; r != NULL; r = r->next) {
+        r->count = 0;
+    }
+    a->end = a->begin;
+}
+
+void arena_free(Arena *a)
+{
+    Region *r = a->begin;
+    while (r != NULL) {
+        Region *next = r->next;
+        free(r);
+        r = next;
+    }
+    a->begin = NULL;
+    a->end = NULL;
+}
@@ -0,0 +1,195 @@
+#include "../include/batch.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#   define BATCH_X86
+#   include <immintrin.h>
+#endif
+
+typedef void (*Batch_Kernel)(void *dst, const void *a, const void *b, size_t n);
+
+// Kernels for add, sub, mul, div in order of opcodes
+typedef struct {
+    Batch_Kernel i64[4];
+    Batch_Kernel f64[4];
+} Batch_Kernels;
+
+#define SCALAR_KERNEL(name, T, operator)                                    \
+    static void name(void *dst, const void *a, const void *b, size_t n)     \
+    {                                                                       \
+        T *d = dst;                                                         \
+        const T *x = a;                                                     \
+        const T *y = b;                                                     \
+        for (size_t i = 0; i < n; ++i) d[i] = x[i] operator y[i];           \
+    }
+
+SCALAR_KERNEL(add_i64_scalar, i64_t, +)
+SCALAR_KERNEL(sub_i64_scalar, i64_t, -)
+SCALAR_KERNEL(mul_i64_scalar, i64_t, *)
+SCALAR_KERNEL(div_i64_scalar, i64_t, /)
+SCALAR_KERNEL(add_f64_scalar, double, +)
+SCALAR_KERNEL(sub_f64_scalar, double, -)
+SCALAR_KERNEL(mul_f64_scalar, double, *)
+SCALAR_KERNEL(div_f64_scalar, double, /)
+
+#ifdef BATCH_X86
+
+// Main loop goes by `width` elements, the tail is done by scalar code
+#define SIMD_KERNEL(name, isa, T, width, load, store, op, operator)        \
+    __attribute__((target(isa)))                                           \
+    static void name(void *dst, const void *a, const void *b, size_t n)    \
+    {                                                                      \
+        T *d = dst;                                                        \
+        const T *x = a;                                                    \
+        const T *y = b;                                                    \
+        size_t i = 0;                                                      \
+        for (; i + (width) <= n; i += (width)) {                           \
+            store(d + i, op(load(x + i), load(y + i)));                    \
+        }                                                                  \
+        for (; i < n; ++i) d[i] = x[i] operator y[i];                      \
+    }
+
+#define LOAD_SI128(p) _mm_loadu_si128((const __m128i *) (p))
+#define STORE_SI128(p, v) _mm_storeu_si128((__m128i *) (p), (v))
+#define LOAD_SI256(p) _mm256_loadu_si256((const __m256i *) (p))
+#define STORE_SI256(p, v) _mm256_storeu_si256((__m256i *) (p), (v))
+
+SIMD_KERNEL(add_i64_sse2, "sse2", i64_t, 2, LOAD_SI128, STORE_SI128, _mm_add_epi64, +)
+SIMD_KERNEL(sub_i64_sse2, "sse2", i64_t, 2, LOAD_SI128, STORE_SI128, _mm_sub_epi64, -)
+SIMD_KERNEL(add_f64_sse2, "sse2", double, 2, _mm_loadu_pd, _mm_storeu_pd, _mm_add_pd, +)
+SIMD_KERNEL(sub_f64_sse2, "sse2", double, 2, _mm_loadu_pd, _mm_storeu_pd, _mm_sub_pd, -)
+SIMD_KERNEL(mul_f64_sse2, "sse2", double, 2, _mm_loadu_pd, _mm_storeu_pd, _mm_mul_pd, *)
+SIMD_KERNEL(div_f64_sse2, "sse2", double, 2, _mm_loadu_pd, _mm_storeu_pd, _mm_div_pd, /)
+
+SIMD_KERNEL(add_i64_avx2, "avx2", i64_t, 4, LOAD_SI256, STORE_SI256, _mm256_add_epi64, +)
+SIMD_KERNEL(sub_i64_avx2, "avx2", i64_t, 4, LOAD_SI256, STORE_SI256, _mm256_sub_epi64, -)
+SIMD_KERNEL(add_f64_avx2, "avx2", double, 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_add_pd, +)
+SIMD_KERNEL(sub_f64_avx2, "avx2", double, 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_sub_pd, -)
+SIMD_KERNEL(mul_f64_avx2, "avx2", double, 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_mul_pd, *)
+SIMD_KERNEL(div_f64_avx2, "avx2", double, 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_div_pd, /)
+
+#endif // BATCH_X86
+
+// Neither SSE2 nor AVX2 has 64-bit integer multiply or divide,
+// so those stay scalar on every target
+static const Batch_Kernels *batch_kernels(void)
+{
+    static const Batch_Kernels scalar = {
+        .i64 = { add_i64_scalar, sub_i64_scalar, mul_i64_scalar, div_i64_scalar },
+        .f64 = { add_f64_scalar, sub_f64_scalar, mul_f64_scalar, div_f64_scalar },
+    };
+
+#ifdef BATCH_X86
+    static const Batch_Kernels sse2 = {
+        .i64 = { add_i64_sse2, sub_i64_sse2, mul_i64_scalar, div_i64_scalar },
+        .f64 = { add_f64_sse2, sub_f64_sse2, mul_f64_sse2, div_f64_sse2 },
+    };
+    static const Batch_Kernels avx2 = {
+        .i64 = { add_i64_avx2, sub_i64_avx2, mul_i64_scalar, div_i64_scalar },
+        .f64 = { add_f64_avx2, sub_f64_avx2, mul_f64_avx2, div_f64_avx2 },
+    };
+
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return &avx2;
+    if (__builtin_cpu_supports("sse2")) return &sse2;
+#endif
+
+    return &scalar;
+}
+
+// Int block as f64, `dst` can be the same block as `src`
+static const void *batch_to_f64(void *dst, const void *src, size_t n)
+{
+    double *d = dst;
+    const i64_t *s = src;
+    for (size_t i = 0; i < n; ++i) d[i] = (double) s[i];
+    return dst;
+}
+
+// One block of scratch per stack slot, plus pointers and types of slots
+#define BATCH_SLOT_BYTES (BATCH_BLOCK * 8 + sizeof(void *) + sizeof(Value_Type))
+
+Value_Type bc_eval_batch(const Program *prog, const Column *cols, size_t rows, void *out, Batch_Scratch *bs)
+{
+    // Threads may race to pick the kernels, they all pick the same ones
+    static const Batch_Kernels *cached = NULL;
+    const Batch_Kernels *kernels = __atomic_load_n(&cached, __ATOMIC_ACQUIRE);
+    if (kernels == NULL) {
+        kernels = batch_kernels();
+        __atomic_store_n(&cached, kernels, __ATOMIC_RELEASE);
+    }
+
+    size_t depth = prog->max_stack;
+    if (depth == 0 || rows == 0) return VAL_INT;
+
+    if (bs->depth < depth) {
+        free(bs->mem);
+        bs->mem = malloc(depth * BATCH_SLOT_BYTES);
+        assert(bs->mem != NULL);
+        bs->depth = depth;
+    }
+    char *scratch = bs->mem;
+    const void **stack = (const void **) (scratch + depth * BATCH_BLOCK * 8);
+    Value_Type *types = (Value_Type *) (stack + depth);
+
+    Value_Type result = VAL_INT;
+    size_t base = 0;
+    do {
+        size_t n = rows - base < BATCH_BLOCK ? rows - base : BATCH_BLOCK;
+        size_t sp = 0;
+
+        for (const Inst *ip = prog->items; ip->op != OP_HALT; ++ip) {
+            switch (ip->op) {
+                case OP_PUSH: {
+                    Value val = prog->consts[ip->arg];
+                    i64_t *slot = (i64_t *) (scratch + sp * BATCH_BLOCK * 8);
+                    for (size_t i = 0; i < n; ++i) slot[i] = val.i64;
+                    stack[sp] = slot;
+                    types[sp++] = val.type;
+                    break;
+                }
+                case OP_LOAD: {
+                    const Column *col = &cols[ip->arg];
+                    stack[sp] = (const char *) col->data + base * 8;
+                    types[sp++] = col->type;
+                    break;
+                }
+                case OP_ADD:
+                case OP_SUB:
+                case OP_MUL:
+                case OP_DIV: {
+                    void *dst = scratch + (sp - 2) * BATCH_BLOCK * 8;
+                    size_t k = ip->op - OP_ADD;
+
+                    // Mixed types: int operand is converted in scratch of its slot
+                    if (types[sp - 2] != types[sp - 1]) {
+                        size_t s = types[sp - 2] == VAL_INT ? sp - 2 : sp - 1;
+                        stack[s] = batch_to_f64(scratch + s * BATCH_BLOCK * 8, stack[s], n);
+                        types[s] = VAL_FLOAT;
+                    }
+
+                    Batch_Kernel kernel = types[sp - 2] == VAL_FLOAT ? kernels->f64[k] : kernels->i64[k];
+                    kernel(dst, stack[sp - 2], stack[sp - 1], n);
+                    stack[sp - 2] = dst;
+                    sp--;
+                    break;
+                }
+                default: {
+                    fprintf(stderr, "Error: unknown opcode `%u`\n", ip->op);
+                    EXIT;
+                }
+            }
+        }
+
+        memcpy((char *) out + base * 8, stack[0], n * 8);
+        result = types[0];
+        base += n;
+    } while (base < rows);
+
+    return result;
+}
+
+void batch_clean(Batch_Scratch *bs)
+{
+    free(bs->mem);
+    *bs = (Batch_Scratch) {0};
+}
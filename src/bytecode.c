@@ -0,0 +1,170 @@
+#include "../include/bytecode.h"
+
+static void bc_emit(Program *prog, Opcode op, uint32_t arg)
+{
+    da_append(prog, ((Inst) { .op = op, .arg = arg }));
+}
+
+static uint32_t bc_push_const(Program *prog, Value val)
+{
+    if (prog->consts_count + 1 >= prog->consts_capacity) {
+        prog->consts_capacity = prog->consts_capacity > 0 ? prog->consts_capacity * 2 : INIT_CAPACITY;
+        prog->consts = realloc(prog->consts, prog->consts_capacity * sizeof(*prog->consts));
+        assert(prog->consts != NULL);
+    }
+    prog->consts[prog->consts_count] = val;
+    return (uint32_t) prog->consts_count++;
+}
+
+// Post-order of the tree is the program itself, depth of value stack
+// is tracked along to size the stack for `bc_eval`
+void bc_compile(Program *prog, Ast *ast)
+{
+    prog->count = 0;
+    prog->consts_count = 0;
+    prog->max_stack = 0;
+
+    const Node_Stack *order = ast_order(ast);
+    size_t depth = 0;
+
+    for (size_t i = 0; i < order->count; ++i) {
+        Ast_Node *node = order->items[i];
+
+        if (node->token.type == TYPE_VALUE) {
+            bc_emit(prog, OP_PUSH, bc_push_const(prog, node->token.val));
+            if (++depth > prog->max_stack) prog->max_stack = depth;
+            continue;
+        }
+
+        if (node->token.type == TYPE_VARIABLE) {
+            bc_emit(prog, OP_LOAD, (uint32_t) node->token.var);
+            if (++depth > prog->max_stack) prog->max_stack = depth;
+            continue;
+        }
+
+        if (node->token.type != TYPE_OPERATOR ||
+            node->left_operand == NULL || node->right_operand == NULL) {
+            fprintf(stderr, "Error: in function `bc_compile` bad node\n");
+            print_node(node);
+            EXIT;
+        }
+
+        switch (node->token.op) {
+            case '+': bc_emit(prog, OP_ADD, 0); break;
+            case '-': bc_emit(prog, OP_SUB, 0); break;
+            case '*': bc_emit(prog, OP_MUL, 0); break;
+            case '/': bc_emit(prog, OP_DIV, 0); break;
+            default: {
+                fprintf(stderr, "Error, unknown operator `%c`\n", node->token.op);
+                EXIT;
+            }
+        }
+        depth--;
+    }
+
+    bc_emit(prog, OP_HALT, 0);
+}
+
+void guard_add(Type_Guards *guards, uint32_t var, Value_Type type)
+{
+    for (size_t i = 0; i < guards->count; ++i) {
+        if (guards->items[i].var == var) return;
+    }
+    da_append(guards, ((Type_Guard) { .var = var, .type = type }));
+}
+
+int guard_check(const Type_Guards *guards, const Var_List *vl)
+{
+    for (size_t i = 0; i < guards->count; ++i) {
+        if (vl->items[guards->items[i].var].val.type != guards->items[i].type) return 0;
+    }
+    return 1;
+}
+
+void bc_clean(Program *prog)
+{
+    free(prog->items);
+    free(prog->consts);
+    *prog = (Program) {0};
+}
+
+// Int branch does not touch types, each branch ends with its own dispatch
+#define BC_BINARY_OP(sp, operator)                                      \
+    do {                                                                \
+        if (__builtin_expect(((sp)[-2].type & (sp)[-1].type) != VAL_INT, 0)) { \
+            VALUE_BINARY_OP((sp)[-2], operator, (sp)[-2], (sp)[-1]);    \
+            (sp)--;                                                     \
+            BC_NEXT();                                                  \
+        }                                                               \
+        (sp)[-2].i64 = (sp)[-2].i64 operator (sp)[-1].i64;              \
+        (sp)--;                                                         \
+        BC_NEXT();                                                      \
+    } while (0)
+
+// Threaded dispatch with GNU computed goto
+#define BC_NEXT() goto *labels[(++ip)->op]
+
+BC_DISPATCH_FN
+Value bc_eval(const Program *prog, const Var_List *vl, Value *stack)
+{
+    static void *labels[OP_COUNT] = {
+        [OP_PUSH] = &&op_push,
+        [OP_LOAD] = &&op_load,
+        [OP_ADD]  = &&op_add,
+        [OP_SUB]  = &&op_sub,
+        [OP_MUL]  = &&op_mul,
+        [OP_DIV]  = &&op_div,
+        [OP_HALT] = &&op_halt,
+    };
+
+    const Inst *ip = prog->items;
+    const Value *consts = prog->consts;
+    Value *sp = stack;
+
+    goto *labels[ip->op];
+
+op_push:
+    *sp++ = consts[ip->arg];
+    BC_NEXT();
+op_load:
+    *sp++ = vl->items[ip->arg].val;
+    BC_NEXT();
+op_add:
+    BC_BINARY_OP(sp, +);
+op_sub:
+    BC_BINARY_OP(sp, -);
+op_mul:
+    BC_BINARY_OP(sp, *);
+op_div:
+    BC_BINARY_OP(sp, /);
+op_halt:
+    return stack[0];
+}
+
+void print_program(Program *prog)
+{
+    static const char *names[OP_COUNT] = {
+        [OP_PUSH] = "push",
+        [OP_LOAD] = "load",
+        [OP_ADD]  = "add",
+        [OP_SUB]  = "sub",
+        [OP_MUL]  = "mul",
+        [OP_DIV]  = "div",
+        [OP_HALT] = "halt",
+    };
+
+    printf("\n------------------------- Bytecode -------------------------\n\n");
+    for (size_t i = 0; i < prog->count; ++i) {
+        Inst inst = prog->items[i];
+        printf("%4zu: %s", i, names[inst.op]);
+        if (inst.op == OP_PUSH) {
+            printf(" ");
+            print_token((Token) { .type = TYPE_VALUE, .val = prog->consts[inst.arg] });
+        } else if (inst.op == OP_LOAD) {
+            printf(" var[%u]\n", inst.arg);
+        } else {
+            printf("\n");
+        }
+    }
+    printf("\n------------------------------------------------------------\n\n");
+}
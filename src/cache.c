@@ -0,0 +1,185 @@
+#include "../include/cache.h"
+
+static void cache_init(Cache *cache)
+{
+    if (cache->capacity == 0) cache->capacity = CACHE_DEFAULT_CAPACITY;
+
+    // Load factor stays under 1/2 as number of entries is bounded
+    cache->index_capacity = INIT_CAPACITY;
+    while (cache->index_capacity < cache->capacity * 2) cache->index_capacity *= 2;
+
+    cache->entries = calloc(cache->capacity, sizeof(*cache->entries));
+    cache->index = calloc(cache->index_capacity, sizeof(*cache->index));
+    assert(cache->entries != NULL && cache->index != NULL);
+}
+
+static void cache_normalize(Cache *cache, String_View src)
+{
+    if (cache->key_capacity < src.count) {
+        cache->key_capacity = src.count;
+        cache->key.data = realloc(cache->key.data, cache->key_capacity);
+        assert(cache->key.data != NULL);
+    }
+
+    cache->key.count = sv_normalize(src, cache->key.data);
+}
+
+// Returns slot in `index` which holds entry with such text or empty slot
+static size_t cache_probe(Cache *cache, String_View key, uint64_t hash)
+{
+    size_t mask = cache->index_capacity - 1;
+    size_t slot = hash & mask;
+
+    while (cache->index[slot] != 0) {
+        Cache_Entry *e = &cache->entries[cache->index[slot] - 1];
+        if (e->hash == hash && sv_cmp((String_View) { .data = e->text, .count = e->text_count }, key)) break;
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+// Backward shift deletion, so probe sequences never need tombstones
+static void cache_unlink(Cache *cache, Cache_Entry *e)
+{
+    size_t mask = cache->index_capacity - 1;
+    size_t hole = cache_probe(cache, (String_View) { .data = e->text, .count = e->text_count }, e->hash);
+    cache->index[hole] = 0;
+
+    for (size_t slot = (hole + 1) & mask; cache->index[slot] != 0; slot = (slot + 1) & mask) {
+        size_t home = cache->entries[cache->index[slot] - 1].hash & mask;
+
+        // Entry may move into the hole only if the hole is on its probe path
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            cache->index[hole] = cache->index[slot];
+            cache->index[slot] = 0;
+            hole = slot;
+        }
+    }
+}
+
+static Cache_Entry *cache_victim(Cache *cache)
+{
+    if (cache->count < cache->capacity) return &cache->entries[cache->count++];
+
+    while (cache->entries[cache->hand].ref) {
+        cache->entries[cache->hand].ref = 0;
+        cache->hand = (cache->hand + 1) % cache->capacity;
+    }
+
+    Cache_Entry *e = &cache->entries[cache->hand];
+    cache->hand = (cache->hand + 1) % cache->capacity;
+    cache_unlink(cache, e);
+    cache->evictions += 1;
+    return e;
+}
+
+static void cache_fill(Cache *cache, Cache_Entry *e, Var_List *vl)
+{
+    Lexer lex = lexer_stream((String_View) { .data = e->text, .count = e->text_count }, vl);
+    parser(&cache->ast, &lex);
+    bc_compile(&e->prog, &cache->ast);
+    ast_reset(&cache->ast);
+    lex_clean(&lex);
+
+    e->vars.count = 0;
+    for (size_t i = 0; i < e->prog.count; ++i) {
+        if (e->prog.items[i].op != OP_LOAD) continue;
+
+        uint32_t var = e->prog.items[i].arg;
+        size_t j = 0;
+        while (j < e->vars.count && e->vars.items[j] != var) j++;
+        if (j == e->vars.count) da_append(&e->vars, var);
+    }
+
+    e->has_val = 0;
+    e->ref = 0;
+}
+
+static Cache_Entry *cache_lookup(Cache *cache, String_View src, Var_List *vl)
+{
+    if (cache->entries == NULL) cache_init(cache);
+
+    cache_normalize(cache, src);
+    uint64_t hash = sv_hash(cache->key);
+
+    size_t slot = cache_probe(cache, cache->key, hash);
+    if (cache->index[slot] != 0) {
+        Cache_Entry *e = &cache->entries[cache->index[slot] - 1];
+        e->ref = 1;
+        cache->hits += 1;
+        return e;
+    }
+
+    cache->misses += 1;
+    Cache_Entry *e = cache_victim(cache);
+
+    if (e->text_capacity < cache->key.count) {
+        e->text_capacity = cache->key.count;
+        e->text = realloc(e->text, e->text_capacity);
+        assert(e->text != NULL);
+    }
+    memcpy(e->text, cache->key.data, cache->key.count);
+    e->text_count = cache->key.count;
+    e->hash = hash;
+
+    // Eviction may have shifted slots, so look for the place again
+    slot = cache_probe(cache, cache->key, hash);
+    cache->index[slot] = (uint32_t) (e - cache->entries + 1);
+
+    cache_fill(cache, e, vl);
+    return e;
+}
+
+const Program *cache_compile(Cache *cache, String_View src, Var_List *vl)
+{
+    return &cache_lookup(cache, src, vl)->prog;
+}
+
+// Cached value is valid while none of its variables was pushed after it
+// was computed. Without variables it is valid forever
+static int cache_val_valid(const Cache_Entry *e, const Var_List *vl)
+{
+    if (!e->has_val) return 0;
+
+    for (size_t i = 0; i < e->vars.count; ++i) {
+        if (vl->items[e->vars.items[i]].stamp > e->stamp) return 0;
+    }
+    return 1;
+}
+
+Value cache_eval(Cache *cache, String_View src, Var_List *vl)
+{
+    Cache_Entry *e = cache_lookup(cache, src, vl);
+
+    if (cache_val_valid(e, vl)) {
+        cache->value_hits += 1;
+        return e->val;
+    }
+
+    if (cache->stack.capacity < e->prog.max_stack) {
+        cache->stack.capacity = e->prog.max_stack;
+        cache->stack.items = realloc(cache->stack.items, cache->stack.capacity * sizeof(*cache->stack.items));
+        assert(cache->stack.items != NULL);
+    }
+
+    e->val = bc_eval(&e->prog, vl, cache->stack.items);
+    e->stamp = vl->tick;
+    e->has_val = 1;
+    return e->val;
+}
+
+void cache_clean(Cache *cache)
+{
+    for (size_t i = 0; i < cache->count; ++i) {
+        free(cache->entries[i].text);
+        bc_clean(&cache->entries[i].prog);
+        da_clean(&cache->entries[i].vars);
+    }
+    free(cache->entries);
+    free(cache->index);
+    free(cache->key.data);
+    ast_clean(&cache->ast);
+    da_clean(&cache->stack);
+    *cache = (Cache) {0};
+}
@@ -0,0 +1,255 @@
+#include <limits.h>
+
+#include "../include/checked.h"
+
+static const char *arith_policy_names[ARITH_POLICY_COUNT] = {
+    [ARITH_WRAP]     = "wrap",
+    [ARITH_TRAP]     = "trap",
+    [ARITH_SATURATE] = "saturate",
+    [ARITH_PROMOTE]  = "promote",
+};
+
+static const char *arith_status_names[ARITH_STATUS_COUNT] = {
+    [ARITH_OK]       = "ok",
+    [ARITH_OVERFLOW] = "overflow",
+    [ARITH_DIV_ZERO] = "division by zero",
+};
+
+const char *arith_policy_name(Arith_Policy policy)
+{
+    return policy < ARITH_POLICY_COUNT ? arith_policy_names[policy] : "unknown";
+}
+
+const char *arith_status_name(Arith_Status status)
+{
+    return status < ARITH_STATUS_COUNT ? arith_status_names[status] : "unknown";
+}
+
+Arith_Status arith_slow(Opcode op, i64_t a, i64_t b, Arith_Policy policy, i64_t *dst)
+{
+    if (op == OP_DIV && b == 0) return ARITH_DIV_ZERO;
+
+    i64_t wrapped;
+    int over;
+    int negative;   // sign of the true result, if it overflows
+    switch (op) {
+        case OP_ADD: over = __builtin_add_overflow(a, b, &wrapped); negative = a < 0; break;
+        case OP_SUB: over = __builtin_sub_overflow(a, b, &wrapped); negative = a < 0; break;
+        case OP_MUL: over = __builtin_mul_overflow(a, b, &wrapped); negative = (a < 0) != (b < 0); break;
+        case OP_DIV: {
+            // INT64_MIN / -1 is the only quotient which does not fit
+            over = a == LLONG_MIN && b == -1;
+            wrapped = over ? a : a / b;
+            negative = 0;
+        } break;
+        default: {
+            fprintf(stderr, "Error: unknown arithmetic op `%u`\n", op);
+            EXIT;
+        }
+    }
+
+    if (!over || policy == ARITH_WRAP) {
+        *dst = wrapped;
+        return ARITH_OK;
+    }
+    if (policy == ARITH_SATURATE) {
+        *dst = negative ? LLONG_MIN : LLONG_MAX;
+        return ARITH_OK;
+    }
+    return ARITH_OVERFLOW;
+}
+
+typedef __int128 i128_t;
+
+#define I128_MIN ((i128_t) ((unsigned __int128) 1 << 127))
+
+// `wide` is the exact value when `val` is VAL_INT, `val.i64` keeps its
+// low 64 bits
+typedef struct {
+    Value val;
+    i128_t wide;
+} Wide_Value;
+
+static Arith_Status wide_op(Opcode op, i128_t a, i128_t b, i128_t *dst)
+{
+    switch (op) {
+        case OP_ADD: return __builtin_add_overflow(a, b, dst) ? ARITH_OVERFLOW : ARITH_OK;
+        case OP_SUB: return __builtin_sub_overflow(a, b, dst) ? ARITH_OVERFLOW : ARITH_OK;
+        case OP_MUL: return __builtin_mul_overflow(a, b, dst) ? ARITH_OVERFLOW : ARITH_OK;
+        case OP_DIV: {
+            if (b == 0) return ARITH_DIV_ZERO;
+            if (a == I128_MIN && b == -1) return ARITH_OVERFLOW;
+            *dst = a / b;
+            return ARITH_OK;
+        }
+        default: {
+            fprintf(stderr, "Error: unknown arithmetic op `%u`\n", op);
+            EXIT;
+        }
+    }
+}
+
+static double wide_float(Opcode op, double a, double b)
+{
+    switch (op) {
+        case OP_ADD: return a + b;
+        case OP_SUB: return a - b;
+        case OP_MUL: return a * b;
+        default:     return a / b;
+    }
+}
+
+// Cold path of PROMOTE, program is run again from the start
+__attribute__((cold, noinline))
+static Value bc_eval_wide(const Program *prog, const Var_List *vl, Arith_Status *status)
+{
+    Wide_Value *stack = malloc(prog->max_stack * sizeof(*stack));
+    assert(stack != NULL);
+    Wide_Value *sp = stack;
+    Value res = VALUE_INT(0);
+
+    for (const Inst *ip = prog->items; ip->op != OP_HALT; ++ip) {
+        if (ip->op == OP_PUSH || ip->op == OP_LOAD) {
+            sp->val = ip->op == OP_PUSH ? prog->consts[ip->arg] : vl->items[ip->arg].val;
+            sp->wide = sp->val.type == VAL_INT ? sp->val.i64 : 0;
+            sp++;
+            continue;
+        }
+
+        Wide_Value *a = &sp[-2];
+        const Wide_Value *b = &sp[-1];
+        sp--;
+
+        // Mixed types are promoted as in VALUE_BINARY_OP
+        if ((a->val.type & b->val.type) != VAL_INT) {
+            double x = a->val.type == VAL_FLOAT ? a->val.f64 : (double) a->wide;
+            double y = b->val.type == VAL_FLOAT ? b->val.f64 : (double) b->wide;
+            a->val = VALUE_FLOAT(wide_float(ip->op, x, y));
+            a->wide = 0;
+            continue;
+        }
+
+        *status = wide_op(ip->op, a->wide, b->wide, &a->wide);
+        if (*status != ARITH_OK) goto done;
+        a->val.i64 = (i64_t) a->wide;
+    }
+
+    *status = ARITH_OK;
+    if (stack[0].val.type == VAL_INT && (stack[0].wide < LLONG_MIN || stack[0].wide > LLONG_MAX)) {
+        *status = ARITH_OVERFLOW;
+    } else {
+        res = stack[0].val;
+    }
+
+done:
+    free(stack);
+    return res;
+}
+
+__attribute__((cold, noinline))
+size_t bc_eval_slow(const Program *prog, const Var_List *vl, Value *stack,
+                    Arith_Policy policy, Arith_Status *status)
+{
+    Value *sp = stack;
+    size_t i = 0;
+
+    for (; prog->items[i].op != OP_HALT; ++i) {
+        Inst inst = prog->items[i];
+        if (inst.op == OP_PUSH) { *sp++ = prog->consts[inst.arg]; continue; }
+        if (inst.op == OP_LOAD) { *sp++ = vl->items[inst.arg].val; continue; }
+
+        sp--;
+        if ((sp[-1].type & sp[0].type) == VAL_INT) {
+            *status = arith_slow(inst.op, sp[-1].i64, sp[0].i64, policy, &sp[-1].i64);
+            if (*status != ARITH_OK) return i;
+            continue;
+        }
+        switch (inst.op) {
+            case OP_ADD: VALUE_BINARY_OP(sp[-1], +, sp[-1], sp[0]); break;
+            case OP_SUB: VALUE_BINARY_OP(sp[-1], -, sp[-1], sp[0]); break;
+            case OP_MUL: VALUE_BINARY_OP(sp[-1], *, sp[-1], sp[0]); break;
+            default:     VALUE_BINARY_OP(sp[-1], /, sp[-1], sp[0]); break;
+        }
+    }
+
+    *status = ARITH_OK;
+    return i;
+}
+
+// Same dispatch as `bc_eval`
+#define CHECKED_NEXT() goto *labels[(++ip)->op]
+
+// Int operation which overflows leaves the fast path, `add` and `sub`
+// fuse with their `jo`, so the check is free when nothing overflows
+#define CHECKED_BINARY_OP(sp, operator, builtin)                                \
+    do {                                                                        \
+        if (__builtin_expect(((sp)[-2].type & (sp)[-1].type) != VAL_INT, 0)) {  \
+            VALUE_BINARY_OP((sp)[-2], operator, (sp)[-2], (sp)[-1]);            \
+            (sp)--;                                                             \
+            CHECKED_NEXT();                                                     \
+        }                                                                       \
+        if (__builtin_expect(builtin((sp)[-2].i64, (sp)[-1].i64, &(sp)[-2].i64), 0)) goto over; \
+        (sp)--;                                                                 \
+        CHECKED_NEXT();                                                         \
+    } while (0)
+
+BC_DISPATCH_FN
+Value bc_eval_checked(const Program *prog, const Var_List *vl, Value *stack,
+                      Arith_Policy policy, Arith_Status *status)
+{
+    static void *labels[OP_COUNT] = {
+        [OP_PUSH] = &&op_push,
+        [OP_LOAD] = &&op_load,
+        [OP_ADD]  = &&op_add,
+        [OP_SUB]  = &&op_sub,
+        [OP_MUL]  = &&op_mul,
+        [OP_DIV]  = &&op_div,
+        [OP_HALT] = &&op_halt,
+    };
+
+    const Inst *ip = prog->items;
+    const Value *consts = prog->consts;
+    Value *sp = stack;
+
+    goto *labels[ip->op];
+
+op_push:
+    *sp++ = consts[ip->arg];
+    CHECKED_NEXT();
+op_load:
+    *sp++ = vl->items[ip->arg].val;
+    CHECKED_NEXT();
+op_add:
+    CHECKED_BINARY_OP(sp, +, __builtin_add_overflow);
+op_sub:
+    CHECKED_BINARY_OP(sp, -, __builtin_sub_overflow);
+op_mul:
+    CHECKED_BINARY_OP(sp, *, __builtin_mul_overflow);
+op_div:
+    if (__builtin_expect((sp[-2].type & sp[-1].type) != VAL_INT, 0)) {
+        VALUE_BINARY_OP(sp[-2], /, sp[-2], sp[-1]);
+        sp--;
+        CHECKED_NEXT();
+    }
+    // Division can not be left for later, it would trap right here
+    if (__builtin_expect(sp[-1].i64 == 0 || (sp[-1].i64 == -1 && sp[-2].i64 == LLONG_MIN), 0)) goto slow;
+    sp[-2].i64 = sp[-2].i64 / sp[-1].i64;
+    sp--;
+    CHECKED_NEXT();
+op_halt:
+    *status = ARITH_OK;
+    return stack[0];
+
+over:
+    // Wrapped result is already the answer of WRAP
+    if (policy == ARITH_WRAP) {
+        sp--;
+        CHECKED_NEXT();
+    }
+
+slow:
+    // Operations are done again in order, so the first one which fails decides
+    if (policy == ARITH_PROMOTE) return bc_eval_wide(prog, vl, status);
+    bc_eval_slow(prog, vl, stack, policy, status);
+    return *status == ARITH_OK ? stack[0] : VALUE_INT(0);
+}
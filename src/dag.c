@@ -0,0 +1,200 @@
+#include "../include/dag.h"
+
+// Constants are compared by bits, so 1 and 1.0 stay different nodes
+static uint64_t dag_hash(uint8_t op, Value val, uint32_t left, uint32_t right)
+{
+    uint64_t h = (uint64_t) op * 0x9E3779B97F4A7C15ULL;
+    h ^= ((uint64_t) left << 32 | right) * 0xC2B2AE3D27D4EB4FULL;
+    h ^= ((uint64_t) val.i64 + val.type) * 0x165667B19E3779F9ULL;
+    h ^= h >> 31;
+    h *= 0xD6E8FEB86659FD93ULL;
+    return h ^ (h >> 32);
+}
+
+static Value dag_key_val(Flat_Op op, Value val)
+{
+    return op == FLAT_VALUE ? val : (Value) {0};
+}
+
+static int dag_equal(Dag *dag, uint32_t id, uint8_t op, Value val, uint32_t left, uint32_t right)
+{
+    if (dag->ops[id] != op || dag->left[id] != left || dag->right[id] != right) return 0;
+    if (op != FLAT_VALUE) return 1;
+    return dag->vals[id].type == val.type && dag->vals[id].i64 == val.i64;
+}
+
+// Returns slot in `index` which holds such node or empty slot
+static size_t dag_probe(Dag *dag, uint8_t op, Value val, uint32_t left, uint32_t right)
+{
+    size_t mask = dag->index_capacity - 1;
+    size_t slot = dag_hash(op, val, left, right) & mask;
+
+    while (dag->index[slot] != 0) {
+        if (dag_equal(dag, dag->index[slot] - 1, op, val, left, right)) break;
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+static void dag_grow(Dag *dag)
+{
+    dag->capacity = dag->capacity > 0 ? dag->capacity * 2 : INIT_CAPACITY;
+    dag->ops = realloc(dag->ops, dag->capacity * sizeof(*dag->ops));
+    dag->vals = realloc(dag->vals, dag->capacity * sizeof(*dag->vals));
+    dag->left = realloc(dag->left, dag->capacity * sizeof(*dag->left));
+    dag->right = realloc(dag->right, dag->capacity * sizeof(*dag->right));
+    dag->epochs = realloc(dag->epochs, dag->capacity * sizeof(*dag->epochs));
+    dag->varying = realloc(dag->varying, dag->capacity * sizeof(*dag->varying));
+    assert(dag->ops != NULL && dag->vals != NULL);
+    assert(dag->epochs != NULL && dag->varying != NULL);
+    assert(dag->left != NULL && dag->right != NULL);
+
+    // Keep load factor of index under 1/2
+    free(dag->index);
+    dag->index_capacity = dag->capacity * 2;
+    dag->index = calloc(dag->index_capacity, sizeof(*dag->index));
+    assert(dag->index != NULL);
+
+    for (size_t i = 0; i < dag->count; ++i) {
+        Value val = dag_key_val(dag->ops[i], dag->vals[i]);
+        size_t slot = dag_probe(dag, dag->ops[i], val, dag->left[i], dag->right[i]);
+        dag->index[slot] = (uint32_t) (i + 1);
+    }
+}
+
+uint32_t dag_node(Dag *dag, Flat_Op op, Value val, uint32_t left, uint32_t right)
+{
+    dag->requested += 1;
+    if (dag->count + 1 >= dag->capacity) dag_grow(dag);
+
+    val = dag_key_val(op, val);
+    size_t slot = dag_probe(dag, op, val, left, right);
+    if (dag->index[slot] != 0) return dag->index[slot] - 1;
+
+    uint32_t id = (uint32_t) dag->count++;
+    dag->ops[id] = op;
+    dag->vals[id] = val;
+    dag->left[id] = left;
+    dag->right[id] = right;
+    dag->epochs[id] = op == FLAT_VALUE ? DAG_FOREVER : 0;
+    dag->varying[id] = op == FLAT_VAR ||
+                       (op != FLAT_VALUE && (dag->varying[left] || dag->varying[right]));
+    dag->index[slot] = id + 1;
+    return id;
+}
+
+// Post-order of the tree is walked as RPN, stack holds ids of operands
+uint32_t dag_add(Dag *dag, Ast *ast)
+{
+    const Node_Stack *order = ast_order(ast);
+    Index_Stack *stack = &dag->stack;
+    stack->count = 0;
+    dag->vl = ast->vl;
+
+    for (size_t i = 0; i < order->count; ++i) {
+        const Ast_Node *node = order->items[i];
+
+        if (node->token.type == TYPE_VALUE) {
+            da_append(stack, dag_node(dag, FLAT_VALUE, node->token.val, 0, 0));
+            continue;
+        }
+        if (node->token.type == TYPE_VARIABLE) {
+            da_append(stack, dag_node(dag, FLAT_VAR, (Value) {0}, (uint32_t) node->token.var, 0));
+            continue;
+        }
+
+        Flat_Op op;
+        switch (node->token.op) {
+            case '+': op = FLAT_ADD; break;
+            case '-': op = FLAT_SUB; break;
+            case '*': op = FLAT_MUL; break;
+            case '/': op = FLAT_DIV; break;
+            default: {
+                fprintf(stderr, "Error: unknown operator `%c`\n", node->token.op);
+                EXIT;
+            }
+        }
+
+        uint32_t right = stack->items[--stack->count];
+        uint32_t left = stack->items[--stack->count];
+        stack->items[stack->count++] = dag_node(dag, op, (Value) {0}, left, right);
+    }
+
+    return stack->items[0];
+}
+
+void dag_next_epoch(Dag *dag)
+{
+    dag->epoch += 1;
+}
+
+static int dag_fresh(const Dag *dag, uint32_t id)
+{
+    return dag->epochs[id] == dag->epoch || dag->epochs[id] == DAG_FOREVER;
+}
+
+// Only nodes reachable from `root` and not yet computed in this epoch
+// are visited. Explicit stack, as shared nodes make the graph deep
+Value dag_eval(Dag *dag, uint32_t root)
+{
+    if (dag->epoch == 0 || dag->tick != dag->vl->tick) {
+        dag->epoch += 1;
+        dag->tick = dag->vl->tick;
+    }
+
+    Index_Stack *stack = &dag->stack;
+    stack->count = 0;
+    da_append(stack, root);
+
+    while (stack->count > 0) {
+        uint32_t id = stack->items[stack->count - 1];
+        if (dag_fresh(dag, id)) {
+            stack->count--;
+            continue;
+        }
+
+        if (dag->ops[id] == FLAT_VAR) {
+            dag->vals[id] = dag->vl->items[dag->left[id]].val;
+        } else {
+            uint32_t l = dag->left[id];
+            uint32_t r = dag->right[id];
+            int ready = 1;
+            if (!dag_fresh(dag, l)) { da_append(stack, l); ready = 0; }
+            if (!dag_fresh(dag, r)) { da_append(stack, r); ready = 0; }
+            if (!ready) continue;
+
+            Value a = dag->vals[l];
+            Value b = dag->vals[r];
+            switch (dag->ops[id]) {
+                case FLAT_ADD: VALUE_BINARY_OP(dag->vals[id], +, a, b); break;
+                case FLAT_SUB: VALUE_BINARY_OP(dag->vals[id], -, a, b); break;
+                case FLAT_MUL: VALUE_BINARY_OP(dag->vals[id], *, a, b); break;
+                case FLAT_DIV: VALUE_BINARY_OP(dag->vals[id], /, a, b); break;
+                default: {
+                    fprintf(stderr, "Error: unknown flat op `%u`\n", dag->ops[id]);
+                    EXIT;
+                }
+            }
+        }
+
+        dag->epochs[id] = dag->varying[id] ? dag->epoch : DAG_FOREVER;
+        dag->evaluated += 1;
+        stack->count--;
+    }
+
+    return dag->vals[root];
+}
+
+void dag_clean(Dag *dag)
+{
+    free(dag->ops);
+    free(dag->vals);
+    free(dag->left);
+    free(dag->right);
+    free(dag->epochs);
+    free(dag->varying);
+    free(dag->index);
+    da_clean(&dag->stack);
+    *dag = (Dag) {0};
+}
@@ -0,0 +1,118 @@
+#include "../include/flat.h"
+
+uint32_t flat_push(Flat_Ast *fa, Flat_Op op, Value val, uint32_t left, uint32_t right)
+{
+    if (fa->count + 1 >= fa->capacity) {
+        fa->capacity = fa->capacity > 0 ? fa->capacity * 2 : INIT_CAPACITY;
+        fa->ops = realloc(fa->ops, fa->capacity * sizeof(*fa->ops));
+        fa->vals = realloc(fa->vals, fa->capacity * sizeof(*fa->vals));
+        fa->left = realloc(fa->left, fa->capacity * sizeof(*fa->left));
+        fa->right = realloc(fa->right, fa->capacity * sizeof(*fa->right));
+        assert(fa->ops != NULL && fa->vals != NULL);
+        assert(fa->left != NULL && fa->right != NULL);
+    }
+
+    fa->ops[fa->count] = op;
+    fa->vals[fa->count] = val;
+    fa->left[fa->count] = left;
+    fa->right[fa->count] = right;
+    return (uint32_t) fa->count++;
+}
+
+void flat_clean(Flat_Ast *fa)
+{
+    free(fa->ops);
+    free(fa->vals);
+    free(fa->left);
+    free(fa->right);
+    da_clean(&fa->stack);
+    *fa = (Flat_Ast) {0};
+}
+
+// Nodes come from post-order of the tree, so a parent is emitted after
+// both operands, and a bad expression was already reported by the parser
+void flat_compile(Flat_Ast *fa, Ast *ast)
+{
+    const Node_Stack *order = ast_order(ast);
+    Index_Stack *stack = &fa->stack;
+    fa->count = 0;
+    fa->vl = ast->vl;
+    stack->count = 0;
+
+    for (size_t i = 0; i < order->count; ++i) {
+        const Ast_Node *node = order->items[i];
+        uint32_t id;
+
+        if (node->token.type == TYPE_VALUE) {
+            id = flat_push(fa, FLAT_VALUE, node->token.val, 0, 0);
+        } else if (node->token.type == TYPE_VARIABLE) {
+            id = flat_push(fa, FLAT_VAR, (Value) {0}, (uint32_t) node->token.var, 0);
+        } else {
+            Flat_Op op;
+            switch (node->token.op) {
+                case '+': op = FLAT_ADD; break;
+                case '-': op = FLAT_SUB; break;
+                case '*': op = FLAT_MUL; break;
+                case '/': op = FLAT_DIV; break;
+                default: {
+                    fprintf(stderr, "Error: unknown operator `%c`\n", node->token.op);
+                    EXIT;
+                }
+            }
+
+            uint32_t right = stack->items[--stack->count];
+            uint32_t left = stack->items[--stack->count];
+            id = flat_push(fa, op, (Value) {0}, left, right);
+        }
+
+        da_append(stack, id);
+    }
+}
+
+// Linear scan: every child is already resolved when its parent is visited
+Value flat_eval(Flat_Ast *fa)
+{
+    assert(fa->count > 0);
+    Value *vals = fa->vals;
+
+    for (size_t i = 0; i < fa->count; ++i) {
+        if (fa->ops[i] == FLAT_VAR) {
+            vals[i] = fa->vl->items[fa->left[i]].val;
+            continue;
+        }
+        Value a = vals[fa->left[i]];
+        Value b = vals[fa->right[i]];
+        switch (fa->ops[i]) {
+            case FLAT_VALUE: break;
+            case FLAT_VAR: break;
+            case FLAT_ADD: VALUE_BINARY_OP(vals[i], +, a, b); break;
+            case FLAT_SUB: VALUE_BINARY_OP(vals[i], -, a, b); break;
+            case FLAT_MUL: VALUE_BINARY_OP(vals[i], *, a, b); break;
+            case FLAT_DIV: VALUE_BINARY_OP(vals[i], /, a, b); break;
+            default: {
+                fprintf(stderr, "Error: unknown flat op `%u`\n", fa->ops[i]);
+                EXIT;
+            }
+        }
+    }
+
+    return vals[fa->count - 1];
+}
+
+void print_flat(Flat_Ast *fa)
+{
+    static const char ops[] = { 0, 0, '+', '-', '*', '/' };
+
+    printf("\n------------------------- Flat AST -------------------------\n\n");
+    for (size_t i = 0; i < fa->count; ++i) {
+        printf("%4zu: ", i);
+        if (fa->ops[i] == FLAT_VALUE) {
+            print_token((Token) { .type = TYPE_VALUE, .val = fa->vals[i] });
+        } else if (fa->ops[i] == FLAT_VAR) {
+            print_token((Token) { .type = TYPE_VARIABLE, .var = fa->left[i] });
+        } else {
+            printf("opr: `%c` left: %u right: %u\n", ops[fa->ops[i]], fa->left[i], fa->right[i]);
+        }
+    }
+    printf("\n------------------------------------------------------------\n\n");
+}
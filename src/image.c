@@ -0,0 +1,407 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/image.h"
+
+#define IMAGE_ALIGN(x) (((x) + 7) & ~(uint64_t) 7)
+
+static void image_text_reserve(Image_Writer *w, size_t n)
+{
+    if (w->text.count + n <= w->text.capacity) return;
+    while (w->text.count + n > w->text.capacity) {
+        w->text.capacity = w->text.capacity > 0 ? w->text.capacity * 2 : INIT_CAPACITY;
+    }
+    w->text.items = realloc(w->text.items, w->text.capacity);
+    assert(w->text.items != NULL);
+}
+
+// Returns slot in writer `index` which holds expr with such text or empty slot
+static size_t image_writer_probe(Image_Writer *w, String_View key, uint64_t hash)
+{
+    size_t mask = w->index_capacity - 1;
+    size_t slot = hash & mask;
+
+    while (w->index[slot] != 0) {
+        Image_Expr *e = &w->exprs.items[w->index[slot] - 1];
+        if (e->hash == hash && e->text_count == key.count &&
+            memcmp(w->text.items + e->text, key.data, key.count) == 0) break;
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+// Load factor stays under 1/2, ids are unique so they are placed by hash only
+static void image_index_grow(Image_Writer *w)
+{
+    free(w->index);
+    w->index_capacity = w->index_capacity > 0 ? w->index_capacity * 2 : INIT_CAPACITY;
+    w->index = calloc(w->index_capacity, sizeof(*w->index));
+    assert(w->index != NULL);
+
+    size_t mask = w->index_capacity - 1;
+    for (size_t i = 0; i < w->exprs.count; ++i) {
+        size_t slot = w->exprs.items[i].hash & mask;
+        while (w->index[slot] != 0) slot = (slot + 1) & mask;
+        w->index[slot] = (uint32_t) (i + 1);
+    }
+}
+
+static uint32_t image_text_offset(size_t offset)
+{
+    if (offset > UINT32_MAX) {
+        fprintf(stderr, "Error: text of image is larger than 4 GiB\n");
+        EXIT;
+    }
+    return (uint32_t) offset;
+}
+
+// Symbol of Var_List index, made on first use
+static uint32_t image_symbol(Image_Writer *w, uint32_t var)
+{
+    while (w->sym_of_var.count <= var) da_append(&w->sym_of_var, 0);
+    if (w->sym_of_var.items[var] != 0) return w->sym_of_var.items[var] - 1;
+
+    Variable *v = &w->vl->items[var];
+    image_text_reserve(w, v->name.count);
+    Image_Symbol sym = {
+        .hash = v->hash,
+        .name = image_text_offset(w->text.count),
+        .name_count = (uint32_t) v->name.count,
+    };
+    memcpy(w->text.items + w->text.count, v->name.data, v->name.count);
+    w->text.count += v->name.count;
+
+    da_append(&w->syms, sym);
+    w->sym_of_var.items[var] = (uint32_t) w->syms.count;
+    return (uint32_t) w->syms.count - 1;
+}
+
+size_t image_add(Image_Writer *w, String_View src, Var_List *vl)
+{
+    w->vl = vl;
+    if ((w->exprs.count + 1) * 2 > w->index_capacity) image_index_grow(w);
+
+    // Source is normalized in place at the end of text, and is kept only if new
+    image_text_reserve(w, src.count);
+    size_t text = w->text.count;
+    String_View key = { .data = w->text.items + text };
+    key.count = sv_normalize(src, key.data);
+    uint64_t hash = sv_hash(key);
+
+    size_t slot = image_writer_probe(w, key, hash);
+    if (w->index[slot] != 0) return w->index[slot] - 1;
+
+    Lexer lex = lexer_stream(key, vl);
+    parser(&w->ast, &lex);
+    bc_compile(&w->prog, &w->ast);
+    ast_reset(&w->ast);
+    lex_clean(&lex);
+
+    w->text.count += key.count;
+    Image_Expr e = {
+        .hash = hash,
+        .text = image_text_offset(text),
+        .text_count = (uint32_t) key.count,
+        .inst = (uint32_t) w->insts.count,
+        .inst_count = (uint32_t) w->prog.count,
+        .consts = (uint32_t) w->consts.count,
+        .const_count = (uint32_t) w->prog.consts_count,
+        .max_stack = (uint32_t) w->prog.max_stack,
+    };
+
+    for (size_t i = 0; i < w->prog.count; ++i) {
+        Inst inst = w->prog.items[i];
+        if (inst.op == OP_LOAD) inst.arg = image_symbol(w, inst.arg);
+        da_append(&w->insts, inst);
+    }
+    for (size_t i = 0; i < w->prog.consts_count; ++i) {
+        Value val = w->prog.consts[i];
+        da_append(&w->consts, ((Image_Value) { .type = val.type, .bits = (uint64_t) val.i64 }));
+    }
+
+    da_append(&w->exprs, e);
+    w->index[slot] = (uint32_t) w->exprs.count;
+    return w->exprs.count - 1;
+}
+
+static int image_write(FILE *f, const void *data, size_t size)
+{
+    static const char zeros[8] = {0};
+    size_t pad = IMAGE_ALIGN(size) - size;
+
+    if (size > 0 && fwrite(data, 1, size, f) != size) return 0;
+    if (pad > 0 && fwrite(zeros, 1, pad, f) != pad) return 0;
+    return 1;
+}
+
+// File is written next to `path` and renamed over it, so a reader never
+// maps a half written image
+int image_save(const Image_Writer *w, const char *path)
+{
+    Image_Header h = {
+        .magic = IMAGE_MAGIC,
+        .version = IMAGE_VERSION,
+        .endian = IMAGE_ENDIAN,
+        .expr_count = w->exprs.count,
+        .sym_count = w->syms.count,
+        .inst_count = w->insts.count,
+        .const_count = w->consts.count,
+        .text_size = w->text.count,
+        .index_capacity = w->index_capacity,
+    };
+
+    uint64_t off = IMAGE_ALIGN(sizeof(h));
+    h.exprs = off;  off += IMAGE_ALIGN(h.expr_count * sizeof(Image_Expr));
+    h.syms = off;   off += IMAGE_ALIGN(h.sym_count * sizeof(Image_Symbol));
+    h.insts = off;  off += IMAGE_ALIGN(h.inst_count * sizeof(Inst));
+    h.consts = off; off += IMAGE_ALIGN(h.const_count * sizeof(Image_Value));
+    h.text = off;   off += IMAGE_ALIGN(h.text_size);
+    h.index = off;  off += IMAGE_ALIGN(h.index_capacity * sizeof(uint32_t));
+    h.file_size = off;
+
+    size_t path_len = strlen(path);
+    char *tmp = malloc(path_len + sizeof(".tmp"));
+    assert(tmp != NULL);
+    memcpy(tmp, path, path_len);
+    memcpy(tmp + path_len, ".tmp", sizeof(".tmp"));
+
+    FILE *f = fopen(tmp, "wb");
+    if (f == NULL) {
+        free(tmp);
+        return 0;
+    }
+
+    int ok = image_write(f, &h, sizeof(h)) &&
+             image_write(f, w->exprs.items, h.expr_count * sizeof(Image_Expr)) &&
+             image_write(f, w->syms.items, h.sym_count * sizeof(Image_Symbol)) &&
+             image_write(f, w->insts.items, h.inst_count * sizeof(Inst)) &&
+             image_write(f, w->consts.items, h.const_count * sizeof(Image_Value)) &&
+             image_write(f, w->text.items, h.text_size) &&
+             image_write(f, w->index, h.index_capacity * sizeof(uint32_t));
+    ok = fclose(f) == 0 && ok;
+    ok = ok && rename(tmp, path) == 0;
+    if (!ok) remove(tmp);
+
+    free(tmp);
+    return ok;
+}
+
+void image_writer_clean(Image_Writer *w)
+{
+    da_clean(&w->exprs);
+    da_clean(&w->syms);
+    da_clean(&w->insts);
+    da_clean(&w->consts);
+    da_clean(&w->text);
+    da_clean(&w->sym_of_var);
+    free(w->index);
+    ast_clean(&w->ast);
+    bc_clean(&w->prog);
+    *w = (Image_Writer) {0};
+}
+
+static int image_section(size_t size, uint64_t off, uint64_t count, size_t elem)
+{
+    return off % 8 == 0 && off <= size && count <= (size - off) / elem;
+}
+
+static int image_check(const Image_Header *h, size_t size)
+{
+    if (size < sizeof(*h)) return 0;
+    if (memcmp(h->magic, IMAGE_MAGIC, sizeof(h->magic)) != 0) return 0;
+    if (h->version != IMAGE_VERSION || h->endian != IMAGE_ENDIAN || h->file_size != size) return 0;
+    if (h->index_capacity & (h->index_capacity - 1)) return 0;
+
+    return image_section(size, h->exprs, h->expr_count, sizeof(Image_Expr)) &&
+           image_section(size, h->syms, h->sym_count, sizeof(Image_Symbol)) &&
+           image_section(size, h->insts, h->inst_count, sizeof(Inst)) &&
+           image_section(size, h->consts, h->const_count, sizeof(Image_Value)) &&
+           image_section(size, h->text, h->text_size, 1) &&
+           image_section(size, h->index, h->index_capacity, sizeof(uint32_t));
+}
+
+int image_load(Image *img, const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(Image_Header)) {
+        close(fd);
+        return 0;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return 0;
+
+    const Image_Header *h = data;
+    if (!image_check(h, st.st_size)) {
+        munmap(data, st.st_size);
+        return 0;
+    }
+
+    // Previous image is closed only when the new one is good
+    image_close(img);
+
+    const char *base = data;
+    img->data = data;
+    img->size = st.st_size;
+    img->header = h;
+    img->exprs = (const Image_Expr *) (base + h->exprs);
+    img->syms = (const Image_Symbol *) (base + h->syms);
+    img->insts = (const Inst *) (base + h->insts);
+    img->consts = (const Image_Value *) (base + h->consts);
+    img->text = base + h->text;
+    img->index = (const uint32_t *) (base + h->index);
+    return 1;
+}
+
+static int image_range(uint64_t start, uint64_t count, uint64_t total)
+{
+    return start <= total && count <= total - start;
+}
+
+size_t image_bind(Image *img, Var_List *vl)
+{
+    const Image_Header *h = img->header;
+    size_t unbound = 0;
+
+    // Checks and programs depend on which symbols are bound, so all are
+    // done again
+    size_t exprs = h->expr_count > 0 ? h->expr_count : 1;
+    free(img->checks);
+    free(img->progs);
+    arena_reset(&img->code);
+    img->checks = calloc(exprs, sizeof(*img->checks));
+    img->progs = calloc(exprs, sizeof(*img->progs));
+    assert(img->checks != NULL && img->progs != NULL);
+
+    img->slots.count = 0;
+    for (size_t i = 0; i < h->sym_count; ++i) {
+        const Image_Symbol *sym = &img->syms[i];
+        size_t var = VAR_NOT_FOUND;
+
+        if (image_range(sym->name, sym->name_count, h->text_size)) {
+            String_View name = { .data = (char *) img->text + sym->name, .count = sym->name_count };
+            var = var_find_hash(vl, name, sym->hash);
+        }
+
+        if (var == VAR_NOT_FOUND || var >= IMAGE_UNBOUND) {
+            da_append(&img->slots, IMAGE_UNBOUND);
+            unbound += 1;
+        } else {
+            da_append(&img->slots, (uint32_t) var);
+        }
+    }
+
+    return unbound;
+}
+
+// Program must be well formed and read only bound symbols
+static int image_check_expr(const Image *img, const Image_Expr *e)
+{
+    const Image_Header *h = img->header;
+    if (e->inst_count == 0 || !image_range(e->inst, e->inst_count, h->inst_count)) return 0;
+    if (e->max_stack > e->inst_count) return 0;
+    if (!image_range(e->consts, e->const_count, h->const_count)) return 0;
+
+    size_t depth = 0;
+    for (size_t i = 0; i < e->inst_count; ++i) {
+        Inst inst = img->insts[e->inst + i];
+        switch (inst.op) {
+            case OP_PUSH: if (inst.arg >= e->const_count) return 0; depth++; break;
+            case OP_LOAD: {
+                if (inst.arg >= h->sym_count || img->slots.items[inst.arg] == IMAGE_UNBOUND) return 0;
+                depth++;
+            } break;
+            case OP_ADD:
+            case OP_SUB:
+            case OP_MUL:
+            case OP_DIV:  if (depth < 2) return 0; depth--; break;
+            case OP_HALT: return i + 1 == e->inst_count && depth == 1;
+            default: return 0;
+        }
+        if (depth > e->max_stack) return 0;
+    }
+
+    return 0;
+}
+
+static void image_program(Image *img, size_t id)
+{
+    const Image_Expr *e = &img->exprs[id];
+    Program *prog = &img->progs[id];
+
+    prog->items = arena_alloc(&img->code, e->inst_count * sizeof(*prog->items));
+    prog->count = e->inst_count;
+    for (size_t i = 0; i < e->inst_count; ++i) {
+        Inst inst = img->insts[e->inst + i];
+        if (inst.op == OP_LOAD) inst.arg = img->slots.items[inst.arg];
+        prog->items[i] = inst;
+    }
+
+    prog->consts = arena_alloc(&img->code, (e->const_count > 0 ? e->const_count : 1) * sizeof(*prog->consts));
+    prog->consts_count = e->const_count;
+    for (size_t i = 0; i < e->const_count; ++i) {
+        const Image_Value *c = &img->consts[e->consts + i];
+        prog->consts[i] = (Value) { .type = c->type, .i64 = (i64_t) c->bits };
+    }
+
+    prog->max_stack = e->max_stack;
+}
+
+size_t image_find(Image *img, String_View src)
+{
+    const Image_Header *h = img->header;
+    if (h == NULL || h->index_capacity == 0) return IMAGE_NOT_FOUND;
+    if (img->checks == NULL) return IMAGE_NOT_FOUND;
+
+    if (img->key_capacity < src.count) {
+        img->key_capacity = src.count;
+        img->key.data = realloc(img->key.data, img->key_capacity);
+        assert(img->key.data != NULL);
+    }
+    img->key.count = sv_normalize(src, img->key.data);
+    uint64_t hash = sv_hash(img->key);
+
+    // Probe is bounded, so broken index can not loop forever
+    size_t mask = h->index_capacity - 1;
+    size_t slot = hash & mask;
+    for (size_t n = 0; n < h->index_capacity && img->index[slot] != 0; ++n, slot = (slot + 1) & mask) {
+        size_t id = img->index[slot] - 1;
+        if (id >= h->expr_count) return IMAGE_NOT_FOUND;
+
+        const Image_Expr *e = &img->exprs[id];
+        if (e->hash != hash || e->text_count != img->key.count) continue;
+        if (!image_range(e->text, e->text_count, h->text_size)) return IMAGE_NOT_FOUND;
+        if (memcmp(img->text + e->text, img->key.data, img->key.count) != 0) continue;
+
+        if (img->checks[id] == IMAGE_CHECK_NONE) {
+            img->checks[id] = image_check_expr(img, e) ? IMAGE_CHECK_OK : IMAGE_CHECK_BAD;
+            if (img->checks[id] == IMAGE_CHECK_OK) image_program(img, id);
+        }
+        return img->checks[id] == IMAGE_CHECK_OK ? id : IMAGE_NOT_FOUND;
+    }
+
+    return IMAGE_NOT_FOUND;
+}
+
+Value image_eval(const Image *img, size_t id, const Var_List *vl, Value *stack)
+{
+    return bc_eval(&img->progs[id], vl, stack);
+}
+
+void image_close(Image *img)
+{
+    if (img->data != NULL) munmap(img->data, img->size);
+    da_clean(&img->slots);
+    free(img->checks);
+    free(img->progs);
+    arena_free(&img->code);
+    free(img->key.data);
+    *img = (Image) {0};
+}
@@ -0,0 +1,205 @@
+#include "../include/incr.h"
+
+static uint32_t incr_node(Incr *inc, Flat_Op op, Value val, uint32_t left, uint32_t right)
+{
+    if (inc->count + 1 >= inc->capacity) {
+        inc->capacity = inc->capacity > 0 ? inc->capacity * 2 : INIT_CAPACITY;
+        inc->ops = realloc(inc->ops, inc->capacity * sizeof(*inc->ops));
+        inc->vals = realloc(inc->vals, inc->capacity * sizeof(*inc->vals));
+        inc->left = realloc(inc->left, inc->capacity * sizeof(*inc->left));
+        inc->right = realloc(inc->right, inc->capacity * sizeof(*inc->right));
+        inc->parent = realloc(inc->parent, inc->capacity * sizeof(*inc->parent));
+        inc->dirty = realloc(inc->dirty, inc->capacity * sizeof(*inc->dirty));
+        assert(inc->ops != NULL && inc->vals != NULL);
+        assert(inc->left != NULL && inc->right != NULL);
+        assert(inc->parent != NULL && inc->dirty != NULL);
+    }
+    if (inc->count >= INCR_ROOT) {
+        fprintf(stderr, "Error: too many nodes for incremental evaluation\n");
+        EXIT;
+    }
+
+    uint32_t id = (uint32_t) inc->count++;
+    inc->ops[id] = op;
+    inc->vals[id] = val;
+    inc->left[id] = left;
+    inc->right[id] = right;
+    inc->parent[id] = 0;
+    inc->dirty[id] = 0;
+    return id;
+}
+
+// Value of a node from values of its children, constants are never changed
+static void incr_compute(Incr *inc, uint32_t id)
+{
+    if (inc->ops[id] == FLAT_VALUE) return;
+    if (inc->ops[id] == FLAT_VAR) {
+        inc->vals[id] = inc->vl->items[inc->left[id]].val;
+        return;
+    }
+
+    Value a = inc->vals[inc->left[id]];
+    Value b = inc->vals[inc->right[id]];
+    switch (inc->ops[id]) {
+        case FLAT_ADD: VALUE_BINARY_OP(inc->vals[id], +, a, b); break;
+        case FLAT_SUB: VALUE_BINARY_OP(inc->vals[id], -, a, b); break;
+        case FLAT_MUL: VALUE_BINARY_OP(inc->vals[id], *, a, b); break;
+        case FLAT_DIV: VALUE_BINARY_OP(inc->vals[id], /, a, b); break;
+        default: {
+            fprintf(stderr, "Error: unknown flat op `%u`\n", inc->ops[id]);
+            EXIT;
+        }
+    }
+}
+
+static void incr_dep(Incr *inc, size_t var, uint32_t id)
+{
+    if (var >= inc->deps_count) {
+        size_t count = inc->deps_count > 0 ? inc->deps_count : INIT_CAPACITY;
+        while (count <= var) count *= 2;
+        inc->deps = realloc(inc->deps, count * sizeof(*inc->deps));
+        assert(inc->deps != NULL);
+        memset(inc->deps + inc->deps_count, 0, (count - inc->deps_count) * sizeof(*inc->deps));
+        inc->deps_count = count;
+    }
+    da_append(&inc->deps[var], id);
+}
+
+// Post-order of the tree is walked as RPN, stack holds ids of operands
+size_t incr_add(Incr *inc, Ast *ast)
+{
+    const Node_Stack *order = ast_order(ast);
+    Index_Stack *stack = &inc->stack;
+    stack->count = 0;
+    inc->vl = ast->vl;
+
+    for (size_t i = 0; i < order->count; ++i) {
+        const Ast_Node *node = order->items[i];
+        uint32_t id;
+
+        if (node->token.type == TYPE_VALUE) {
+            id = incr_node(inc, FLAT_VALUE, node->token.val, 0, 0);
+        } else if (node->token.type == TYPE_VARIABLE) {
+            id = incr_node(inc, FLAT_VAR, (Value) {0}, (uint32_t) node->token.var, 0);
+            incr_dep(inc, node->token.var, id);
+        } else {
+            Flat_Op op;
+            switch (node->token.op) {
+                case '+': op = FLAT_ADD; break;
+                case '-': op = FLAT_SUB; break;
+                case '*': op = FLAT_MUL; break;
+                case '/': op = FLAT_DIV; break;
+                default: {
+                    fprintf(stderr, "Error: unknown operator `%c`\n", node->token.op);
+                    EXIT;
+                }
+            }
+
+            uint32_t right = stack->items[--stack->count];
+            uint32_t left = stack->items[--stack->count];
+            id = incr_node(inc, op, (Value) {0}, left, right);
+            inc->parent[left] = id;
+            inc->parent[right] = id;
+        }
+
+        incr_compute(inc, id);
+        da_append(stack, id);
+    }
+
+    uint32_t root = stack->items[0];
+    inc->parent[root] = INCR_ROOT | (uint32_t) inc->roots.count;
+    da_append(&inc->roots, root);
+
+    // Values are current, so the first update has nothing to compute again.
+    // Later expressions can not move the tick, pushes since the last update
+    // are still pending for earlier ones
+    if (inc->roots.count == 1) inc->tick = inc->vl->tick;
+    return inc->roots.count - 1;
+}
+
+// Path to the root is marked up to the first node which is already dirty,
+// as everything above it is marked too
+static void incr_mark(Incr *inc, uint32_t id)
+{
+    while (!inc->dirty[id]) {
+        inc->dirty[id] = 1;
+        da_append(&inc->queue, id);
+        if (inc->parent[id] & INCR_ROOT) break;
+        id = inc->parent[id];
+    }
+}
+
+static int incr_cmp(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *) a;
+    uint32_t y = *(const uint32_t *) b;
+    return (x > y) - (x < y);
+}
+
+static void incr_mark_var(Incr *inc, size_t var)
+{
+    if (var >= inc->deps_count) return;
+    for (size_t i = 0; i < inc->deps[var].count; ++i) incr_mark(inc, inc->deps[var].items[i]);
+}
+
+// Variables pushed since the last update are taken from the log of the
+// list, each one at its latest push, or found by their stamps if the log
+// has been overwritten since. Dirty nodes are computed in order of ids,
+// so children are ready first
+const Index_Stack *incr_update(Incr *inc)
+{
+    inc->changed.count = 0;
+    inc->queue.count = 0;
+    if (inc->vl == NULL) return &inc->changed;
+
+    Var_List *vl = inc->vl;
+    if (vl->tick - inc->tick <= VAR_LOG) {
+        for (uint64_t t = inc->tick + 1; t <= vl->tick; ++t) {
+            uint32_t v = vl->log[t % VAR_LOG];
+            if (vl->items[v].stamp == t) incr_mark_var(inc, v);
+        }
+    } else {
+        for (size_t v = 0; v < vl->count; ++v) {
+            if (vl->items[v].stamp > inc->tick) incr_mark_var(inc, v);
+        }
+    }
+    inc->tick = vl->tick;
+
+    qsort(inc->queue.items, inc->queue.count, sizeof(*inc->queue.items), incr_cmp);
+    for (size_t i = 0; i < inc->queue.count; ++i) {
+        uint32_t id = inc->queue.items[i];
+        Value old = inc->vals[id];
+        incr_compute(inc, id);
+        inc->dirty[id] = 0;
+
+        Value val = inc->vals[id];
+        if ((inc->parent[id] & INCR_ROOT) && (old.type != val.type || old.i64 != val.i64)) {
+            da_append(&inc->changed, inc->parent[id] & ~INCR_ROOT);
+        }
+    }
+    inc->recomputed += inc->queue.count;
+
+    return &inc->changed;
+}
+
+Value incr_value(const Incr *inc, size_t expr)
+{
+    return inc->vals[inc->roots.items[expr]];
+}
+
+void incr_clean(Incr *inc)
+{
+    free(inc->ops);
+    free(inc->vals);
+    free(inc->left);
+    free(inc->right);
+    free(inc->parent);
+    free(inc->dirty);
+    for (size_t i = 0; i < inc->deps_count; ++i) da_clean(&inc->deps[i]);
+    free(inc->deps);
+    da_clean(&inc->roots);
+    da_clean(&inc->changed);
+    da_clean(&inc->queue);
+    da_clean(&inc->stack);
+    *inc = (Incr) {0};
+}
@@ -0,0 +1,182 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/io.h"
+
+int io_map(const char *path, String_View *sv)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return 0;
+    }
+
+    // Empty file can not be mapped, but it is a valid empty input
+    *sv = (String_View) {0};
+    if (st.st_size > 0) {
+        void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            return 0;
+        }
+        madvise(data, st.st_size, MADV_SEQUENTIAL);
+        *sv = (String_View) { .data = data, .count = st.st_size };
+    }
+
+    close(fd);
+    return 1;
+}
+
+void io_unmap(String_View sv)
+{
+    if (sv.data != NULL) munmap(sv.data, sv.count);
+}
+
+int writer_flush(Writer *w)
+{
+    size_t done = 0;
+    while (!w->failed && done < w->count) {
+        ssize_t n = write(w->fd, w->items + done, w->count - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) w->failed = 1;
+        else done += n;
+    }
+    w->count = 0;
+    return !w->failed;
+}
+
+// Room for `n` more bytes, `n` must not be larger than capacity
+static char *writer_reserve(Writer *w, size_t n)
+{
+    if (w->items == NULL) {
+        if (w->capacity == 0) w->capacity = WRITER_DEFAULT_CAPACITY;
+        if (w->capacity < WRITER_VALUE_MAX) w->capacity = WRITER_VALUE_MAX;
+        w->items = malloc(w->capacity);
+        assert(w->items != NULL);
+    }
+    if (w->count + n > w->capacity) writer_flush(w);
+    return w->items + w->count;
+}
+
+// Large writes go around the buffer
+void writer_write(Writer *w, const char *data, size_t count)
+{
+    writer_reserve(w, 0);
+    if (count > w->capacity / 2) {
+        writer_flush(w);
+        Writer direct = { .items = (char *) data, .count = count, .fd = w->fd, .failed = w->failed };
+        w->failed = !writer_flush(&direct);
+        return;
+    }
+
+    memcpy(writer_reserve(w, count), data, count);
+    w->count += count;
+}
+
+// Same text as `print_token` gives for the value, one per line
+void writer_value(Writer *w, Value val)
+{
+    char *p = writer_reserve(w, WRITER_VALUE_MAX);
+
+    if (val.type == VAL_FLOAT) {
+        w->count += snprintf(p, WRITER_VALUE_MAX, "%lf\n", val.f64);
+        return;
+    }
+
+    // Digits are made from the end, no format string is parsed
+    char digits[20];
+    size_t n = 0;
+    uint64_t u = val.i64 < 0 ? -(uint64_t) val.i64 : (uint64_t) val.i64;
+    do {
+        digits[n++] = '0' + u % 10;
+        u /= 10;
+    } while (u > 0);
+
+    if (val.i64 < 0) *p++ = '-';
+    for (size_t i = 0; i < n; ++i) p[i] = digits[n - i - 1];
+    p[n] = '\n';
+    w->count += n + 1 + (val.i64 < 0);
+}
+
+void writer_clean(Writer *w)
+{
+    free(w->items);
+    w->items = NULL;
+    w->count = 0;
+}
+
+// Bad expression gives `error: <pos>: <message>` line in place of its result
+static void writer_error(Writer *w, size_t pos, const char *message)
+{
+    char line[EXPR_ERROR_MESSAGE + 64];
+    int n = snprintf(line, sizeof(line), "error: %zu: %s\n", pos, message);
+    writer_write(w, line, (size_t) n < sizeof(line) ? (size_t) n : sizeof(line) - 1);
+}
+
+// Instruction `i` is node `i` of the post-order. Overflow which only
+// PROMOTE would see is put on the root
+static size_t io_arith_pos(Ast *ast, const Program *prog, const Var_List *vl,
+                           Value *stack, Arith_Policy policy)
+{
+    const Node_Stack *order = ast_order(ast);
+    Arith_Status status;
+    size_t i = bc_eval_slow(prog, vl, stack, policy == ARITH_PROMOTE ? ARITH_WRAP : policy, &status);
+    return order->items[i < order->count ? i : order->count - 1]->token.pos;
+}
+
+size_t io_eval(String_View input, Var_List *vl, Ast *ast, Arith_Policy policy,
+               Writer *w, size_t *failed)
+{
+    size_t count = 0;
+    const char *p = input.data;
+    const char *end = input.data + input.count;
+    Expr_Error err;
+    Program prog = {0};
+    Value_Stack stack = {0};
+
+    while (p < end) {
+        const char *q = p;
+        while (q < end && *q != '\n' && *q != ',') q++;
+
+        String_View src = sv_trim((String_View) { .data = (char *) p, .count = q - p });
+        p = q + 1;
+        if (src.count == 0) continue;
+
+        if (expr_parse(ast, src, vl, &err) != EXPR_OK) {
+            writer_error(w, err.pos, err.message);
+            if (failed != NULL) *failed += 1;
+            continue;
+        }
+
+        // Integer division by zero must not kill the batch, so the checked
+        // evaluator is used with any policy
+        bc_compile(&prog, ast);
+        if (stack.capacity < prog.max_stack) {
+            stack.capacity = prog.max_stack;
+            stack.items = realloc(stack.items, stack.capacity * sizeof(*stack.items));
+            assert(stack.items != NULL);
+        }
+
+        Arith_Status status;
+        Value val = bc_eval_checked(&prog, vl, stack.items, policy, &status);
+        if (status != ARITH_OK) {
+            size_t pos = io_arith_pos(ast, &prog, vl, stack.items, policy);
+            writer_error(w, pos, arith_status_name(status));
+            if (failed != NULL) *failed += 1;
+        } else {
+            writer_value(w, val);
+            count += 1;
+        }
+        ast_reset(ast);
+    }
+
+    bc_clean(&prog);
+    free(stack.items);
+    return count;
+}
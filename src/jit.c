@@ -0,0 +1,266 @@
+#include <stddef.h>
+
+#include "../include/jit.h"
+
+#ifdef JIT_X86_64
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+typedef struct {
+    uint8_t *items;
+    size_t count;
+    size_t capacity;
+} Jit_Buf;
+
+enum { RAX = 0, RCX = 1, RSP = 4, RSI = 6, RDI = 7, R8 = 8, R9 = 9, R10 = 10, R11 = 11 };
+
+// Stack slots of the program live in registers, deeper ones in the frame.
+// Slot `i` of i64 goes to jit_gprs[i], of f64 to xmm`i`. rax, r11, rdx
+// and xmm8, xmm9 are scratch, rdi holds variables
+static const int jit_gprs[] = { RCX, RSI, R8, R9, R10 };
+
+#define JIT_GPRS (sizeof(jit_gprs) / sizeof(jit_gprs[0]))
+#define JIT_XMMS 8
+#define XMM_A 8
+#define XMM_B 9
+
+static void jit_bytes(Jit_Buf *b, uint64_t x, int n)
+{
+    for (int i = 0; i < n; ++i) da_append(b, (uint8_t) (x >> (8 * i)));
+}
+
+// [prefix] [REX] opcode ModRM, where `rm` is register or [rm + disp32] if `mem`.
+// Opcode bytes are given most significant first, as in manuals: 0x0F58
+static void jit_inst(Jit_Buf *b, uint8_t prefix, int w, uint32_t opcode, int opcode_len,
+                     int reg, int rm, int mem, int32_t disp)
+{
+    if (prefix) jit_bytes(b, prefix, 1);
+
+    uint8_t rex = 0x40 | (w ? 8 : 0) | ((reg >> 3) & 1) << 2 | ((rm >> 3) & 1);
+    if (rex != 0x40) jit_bytes(b, rex, 1);
+
+    for (int i = opcode_len - 1; i >= 0; --i) jit_bytes(b, opcode >> (8 * i), 1);
+
+    if (!mem) {
+        jit_bytes(b, 0xC0 | (reg & 7) << 3 | (rm & 7), 1);
+        return;
+    }
+    jit_bytes(b, 0x80 | (reg & 7) << 3 | (rm & 7), 1);
+    if ((rm & 7) == RSP) jit_bytes(b, 0x24, 1);    // SIB: no index
+    jit_bytes(b, (uint32_t) disp, 4);
+}
+
+static int32_t jit_disp(size_t slot)
+{
+    return (int32_t) (slot * 8);
+}
+
+// Bits of a slot to general purpose register
+static void jit_load_gpr(Jit_Buf *b, int dst, size_t slot, Value_Type type)
+{
+    if (type == VAL_FLOAT && slot < JIT_XMMS) {
+        jit_inst(b, 0x66, 1, 0x0F7E, 2, (int) slot, dst, 0, 0);        // movq dst, xmm
+    } else if (type == VAL_INT && slot < JIT_GPRS) {
+        jit_inst(b, 0, 1, 0x89, 1, jit_gprs[slot], dst, 0, 0);         // mov dst, gpr
+    } else {
+        jit_inst(b, 0, 1, 0x8B, 1, dst, RSP, 1, jit_disp(slot));      // mov dst, [rsp + d]
+    }
+}
+
+static void jit_store_gpr(Jit_Buf *b, int src, size_t slot, Value_Type type)
+{
+    if (type == VAL_FLOAT && slot < JIT_XMMS) {
+        jit_inst(b, 0x66, 1, 0x0F6E, 2, (int) slot, src, 0, 0);        // movq xmm, src
+    } else if (type == VAL_INT && slot < JIT_GPRS) {
+        jit_inst(b, 0, 1, 0x89, 1, src, jit_gprs[slot], 0, 0);         // mov gpr, src
+    } else {
+        jit_inst(b, 0, 1, 0x89, 1, src, RSP, 1, jit_disp(slot));      // mov [rsp + d], src
+    }
+}
+
+// Bits of a slot to xmm register
+static void jit_load_xmm(Jit_Buf *b, int dst, size_t slot, Value_Type type)
+{
+    if (type == VAL_FLOAT && slot < JIT_XMMS) {
+        jit_inst(b, 0x66, 0, 0x0F28, 2, dst, (int) slot, 0, 0);        // movapd dst, xmm
+    } else if (type == VAL_INT && slot < JIT_GPRS) {
+        jit_inst(b, 0x66, 1, 0x0F6E, 2, dst, jit_gprs[slot], 0, 0);    // movq dst, gpr
+    } else {
+        jit_inst(b, 0xF2, 0, 0x0F10, 2, dst, RSP, 1, jit_disp(slot)); // movsd dst, [rsp + d]
+    }
+}
+
+// Slot as f64 in xmm register, i64 slot is converted
+static void jit_load_f64(Jit_Buf *b, int dst, size_t slot, Value_Type type)
+{
+    if (type == VAL_FLOAT) {
+        jit_load_xmm(b, dst, slot, type);
+        return;
+    }
+    jit_load_gpr(b, RAX, slot, type);
+    jit_inst(b, 0xF2, 1, 0x0F2A, 2, dst, RAX, 0, 0);                    // cvtsi2sd dst, rax
+}
+
+static void jit_store_xmm(Jit_Buf *b, int src, size_t slot)
+{
+    if (slot < JIT_XMMS) {
+        jit_inst(b, 0x66, 0, 0x0F28, 2, (int) slot, src, 0, 0);        // movapd xmm, src
+    } else {
+        jit_inst(b, 0xF2, 0, 0x0F11, 2, src, RSP, 1, jit_disp(slot)); // movsd [rsp + d], src
+    }
+}
+
+// Type of every slot is known while walking the program, so types of
+// results follow VALUE_BINARY_OP: i64 only if both operands are i64,
+// otherwise i64 operand is converted by cvtsi2sd
+static int jit_emit(Jit *jit, const Var_List *vl, Jit_Buf *b)
+{
+    const Program *prog = &jit->prog;
+    size_t frame = (prog->max_stack * 8 + 15) & ~(size_t) 15;
+    if (frame > INT32_MAX) return 0;
+
+    Value_Type *types = calloc(prog->max_stack + 1, sizeof(Value_Type));
+    assert(types != NULL);
+
+    if (frame > 0) {
+        jit_bytes(b, 0xEC8148, 3);                                      // sub rsp, imm32
+        jit_bytes(b, frame, 4);
+    }
+
+    size_t sp = 0;
+    for (size_t i = 0; i < prog->count && prog->items[i].op != OP_HALT; ++i) {
+        Inst inst = prog->items[i];
+
+        switch (inst.op) {
+            case OP_PUSH: {
+                Value val = prog->consts[inst.arg];
+                jit_bytes(b, 0xB848, 2);                                // mov rax, imm64
+                jit_bytes(b, (uint64_t) val.i64, 8);
+                jit_store_gpr(b, RAX, sp, val.type);
+                types[sp++] = val.type;
+            } break;
+
+            case OP_LOAD: {
+                size_t off = inst.arg * sizeof(Variable) + offsetof(Variable, val) + offsetof(Value, i64);
+                if (off > INT32_MAX) {
+                    free(types);
+                    return 0;
+                }
+                Value_Type type = vl->items[inst.arg].val.type;
+                guard_add(&jit->guards, inst.arg, type);
+                jit_inst(b, 0, 1, 0x8B, 1, RAX, RDI, 1, (int32_t) off); // mov rax, [rdi + off]
+                jit_store_gpr(b, RAX, sp, type);
+                types[sp++] = type;
+            } break;
+
+            default: {
+                size_t l = sp - 2;
+                size_t r = sp - 1;
+
+                if (types[l] == VAL_INT && types[r] == VAL_INT) {
+                    jit_load_gpr(b, RAX, l, types[l]);
+                    jit_load_gpr(b, R11, r, types[r]);
+                    switch (inst.op) {
+                        case OP_ADD: jit_inst(b, 0, 1, 0x01, 1, R11, RAX, 0, 0); break;    // add rax, r11
+                        case OP_SUB: jit_inst(b, 0, 1, 0x29, 1, R11, RAX, 0, 0); break;    // sub rax, r11
+                        case OP_MUL: jit_inst(b, 0, 1, 0x0FAF, 2, RAX, R11, 0, 0); break;  // imul rax, r11
+                        case OP_DIV: {
+                            jit_bytes(b, 0x9948, 2);                                       // cqo
+                            jit_inst(b, 0, 1, 0xF7, 1, 7, R11, 0, 0);                      // idiv r11
+                        } break;
+                        default: assert(0 && "unreachable");
+                    }
+                    jit_store_gpr(b, RAX, l, VAL_INT);
+                } else {
+                    static const uint8_t sse[OP_COUNT] = {
+                        [OP_ADD] = 0x58, [OP_SUB] = 0x5C, [OP_MUL] = 0x59, [OP_DIV] = 0x5E,
+                    };
+                    jit_load_f64(b, XMM_A, l, types[l]);
+                    jit_load_f64(b, XMM_B, r, types[r]);
+                    jit_inst(b, 0xF2, 0, 0x0F00 | sse[inst.op], 2, XMM_A, XMM_B, 0, 0);  // op xmm8, xmm9
+                    jit_store_xmm(b, XMM_A, l);
+                    types[l] = VAL_FLOAT;
+                }
+                sp--;
+            }
+        }
+    }
+
+    jit->type = types[0];
+    jit_load_gpr(b, RAX, 0, types[0]);
+    if (frame > 0) {
+        jit_bytes(b, 0xC48148, 3);                                      // add rsp, imm32
+        jit_bytes(b, frame, 4);
+    }
+    jit_bytes(b, 0xC3, 1);                                              // ret
+
+    free(types);
+    return 1;
+}
+
+// Code is written while mapping is writable, then it becomes read + exec
+static int jit_map(Jit *jit, const Jit_Buf *b)
+{
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    size_t size = (b->count + page - 1) / page * page;
+
+    void *code = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) return 0;
+
+    memcpy(code, b->items, b->count);
+    if (mprotect(code, size, PROT_READ | PROT_EXEC) != 0) {
+        munmap(code, size);
+        return 0;
+    }
+
+    jit->func = (Jit_Func) code;
+    jit->code_size = size;
+    return 1;
+}
+
+#endif // JIT_X86_64
+
+static void jit_unmap(Jit *jit)
+{
+#ifdef JIT_X86_64
+    if (jit->func != NULL) munmap((void *) jit->func, jit->code_size);
+#endif
+    jit->func = NULL;
+    jit->code_size = 0;
+}
+
+int jit_compile(Jit *jit, Ast *ast)
+{
+    jit_unmap(jit);
+    jit->guards.count = 0;
+    bc_compile(&jit->prog, ast);
+
+#ifdef JIT_X86_64
+    Jit_Buf b = {0};
+    int ok = jit_emit(jit, ast->vl, &b) && jit_map(jit, &b);
+    da_clean(&b);
+    return ok;
+#else
+    return 0;
+#endif
+}
+
+Value jit_eval(const Jit *jit, const Var_List *vl, Value *stack)
+{
+    if (jit->func != NULL && guard_check(&jit->guards, vl)) {
+        Value res = { .type = jit->type };
+        res.i64 = (i64_t) jit->func(vl->items);
+        return res;
+    }
+
+    return bc_eval(&jit->prog, vl, stack);
+}
+
+void jit_clean(Jit *jit)
+{
+    jit_unmap(jit);
+    bc_clean(&jit->prog);
+    da_clean(&jit->guards);
+    *jit = (Jit) {0};
+}
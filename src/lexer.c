@@ -1,95 +1,208 @@
+#include <stdarg.h>
+
 #include "../include/lexer.h"
+#include "../include/number.h"
 
-Value tokenise_value(String_View sv)
-{
-    int is_float = sv_is_float(sv);
+const uint8_t op_prec[256] = {
+    ['+'] = 1,
+    ['-'] = 1,
+    ['*'] = 2,
+    ['/'] = 2,
+};
 
-    if (is_float) {
-        char *float_cstr = malloc(sizeof(char) * sv.count + 1);
-        char *endptr = float_cstr; 
-        memcpy(float_cstr, sv.data, sv.count);
+static const char *expr_status_names[EXPR_STATUS_COUNT] = {
+    [EXPR_OK]           = "ok",
+    [EXPR_ERR_NUMBER]   = "number",
+    [EXPR_ERR_CHAR]     = "char",
+    [EXPR_ERR_OPERATOR] = "operator",
+    [EXPR_ERR_VARIABLE] = "variable",
+    [EXPR_ERR_SYNTAX]   = "syntax",
+};
 
-        double d = strtod(float_cstr, &float_cstr);
+const char *expr_status_name(Expr_Status status)
+{
+    return status < EXPR_STATUS_COUNT ? expr_status_names[status] : "unknown";
+}
 
-        if (d == 0 && endptr == float_cstr) {
-            fprintf(stderr, "Error: cannot parse `%s` to float64\n",float_cstr);
-            EXIT;
-        }
+void expr_error(Expr_Error *err, Expr_Status status, size_t pos, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
 
-        return VALUE_FLOAT(d);
+    if (err == NULL) {
+        fprintf(stderr, "Error: ");
+        vfprintf(stderr, fmt, args);
+        fprintf(stderr, " at %zu\n", pos);
+        va_end(args);
+        EXIT;
+    }
+
+    if (err->status == EXPR_OK) {
+        err->status = status;
+        err->pos = pos;
+        vsnprintf(err->message, sizeof(err->message), fmt, args);
+    }
+    va_end(args);
+}
 
+static int lex_value(String_View sv, Value *val)
+{
+    if (sv_is_float(sv)) {
+        val->type = VAL_FLOAT;
+        return number_parse_f64(sv, &val->f64);
     } else {
-        int64_t value = sv_to_int(sv);
-        return VALUE_INT(value);
+        val->type = VAL_INT;
+        return number_parse_i64(sv, &val->i64);
     }
 }
 
+Value tokenise_value(String_View sv)
+{
+    Value val;
+    if (!lex_value(sv, &val)) {
+        fprintf(stderr, "Error: cannot parse `"SV_Fmt"` to %s\n", SV_Args(sv),
+                val.type == VAL_FLOAT ? "float64" : "int64");
+        EXIT;
+    }
+    return val;
+}
+
 void lex_clean(Lexer *lex) { da_clean(lex); }
 void lex_push(Lexer *lex, Token tk) { da_append(lex, tk); }
 
-Lexer lexer(String_View src_sv, Var_List *vl)
+// Cut one token from the front of `src`, `src` must be trimmed from left.
+// Returns 0 and reports to `lex->err` if there is no valid token
+static int lex_scan(Lexer *lex, String_View *src, Token *tk)
 {
-    Lexer lex = {0};
-    String_View src = sv_trim(src_sv);
-    const String_View special = sv_from_cstr("+-*/%()");
-    
-    while (src.count != 0) {
-        Token tk;
-        if (isdigit(src.data[0])) {
-            String_View value = sv_cut_value(&src);
-            tk.val = tokenise_value(value);
-            tk.type = TYPE_VALUE;
-            sv_cut_space_left(&src);
-
-        } else if (char_in_sv(special, src.data[0])){
-            switch(src.data[0]) {
-                case '(': tk.type = TYPE_OPEN_BRACKET;  break;
-                case ')': tk.type = TYPE_CLOSE_BRACKET; break;
-
-                case '/': tk.type = TYPE_OPERATOR;   break;
-                case '%': tk.type = TYPE_OPERATOR;   break;
-                case '+': tk.type = TYPE_OPERATOR;  break;
-                case '*': tk.type = TYPE_OPERATOR;  break;
-                case '-': tk.type = TYPE_OPERATOR; break;
-
-                default:
-                    fprintf(stderr, "Error: unknown operator `%c`\n", src.data[0]);
-                    EXIT;
-            }
+    uint8_t cls = sv_class[(unsigned char) src->data[0]];
+    size_t pos = src->data - lex->origin;
+    tk->pos = (uint32_t) pos;
 
-            tk.op = src.data[0];
-            sv_cut_left(&src, 1);
-            sv_cut_space_left(&src);
-
-        } else if (isalpha(src.data[0])){
-            String_View var_name = sv_cut_part(&src);
-            Variable var = var_search(vl, var_name);
-            
-            if (sv_cmp(var.name, VAR_NONE.name)) {
-                fprintf(stderr, "Unknown variable\n");
-                EXIT;
-            }
+    if (cls & SV_DIGIT) {
+        String_View value = sv_cut_value(src);
+        if (!lex_value(value, &tk->val)) {
+            expr_error(lex->err, EXPR_ERR_NUMBER, pos, "cannot parse `"SV_Fmt"` to %s", SV_Args(value),
+                       tk->val.type == VAL_FLOAT ? "float64" : "int64");
+            return 0;
+        }
+        tk->type = TYPE_VALUE;
+        sv_cut_space_left(src);
 
-            tk.type = TYPE_VALUE;
-            tk.val = var.val;
-            sv_cut_space_left(&src);
+    } else if (cls & SV_SPECIAL) {
+        switch(src->data[0]) {
+            case '(': tk->type = TYPE_OPEN_BRACKET;  break;
+            case ')': tk->type = TYPE_CLOSE_BRACKET; break;
 
-        } else {
-            fprintf(stderr, "Error: cannot tokenize\n");
-            EXIT;
+            case '/': tk->type = TYPE_OPERATOR;   break;
+            case '%': tk->type = TYPE_OPERATOR;   break;
+            case '+': tk->type = TYPE_OPERATOR;  break;
+            case '*': tk->type = TYPE_OPERATOR;  break;
+            case '-': tk->type = TYPE_OPERATOR; break;
+
+            default:
+                expr_error(lex->err, EXPR_ERR_OPERATOR, pos, "unknown operator `%c`", src->data[0]);
+                return 0;
         }
+
+        tk->op = src->data[0];
+        sv_cut_left(src, 1);
+        sv_cut_space_left(src);
+
+    } else if (cls & SV_ALPHA) {
+        String_View var_name = sv_cut_part(src);
+        size_t var = var_find(lex->vl, var_name);
+        
+        if (var == VAR_NOT_FOUND) {
+            expr_error(lex->err, EXPR_ERR_VARIABLE, pos, "unknown variable `"SV_Fmt"`", SV_Args(var_name));
+            return 0;
+        }
+
+        tk->type = TYPE_VARIABLE;
+        tk->var = var;
+        sv_cut_space_left(src);
+
+    } else {
+        expr_error(lex->err, EXPR_ERR_CHAR, pos, "cannot tokenize `%c`", src->data[0]);
+        return 0;
+    }
+
+    STATS_ADD(STAT_TOKENS, 1);
+    return 1;
+}
+
+// New expression starts with clean `err`
+Lexer lexer_try(String_View src_sv, Var_List *vl, Expr_Error *err)
+{
+    STATS_TIME_BEGIN(start);
+    if (err != NULL) err->status = EXPR_OK;
+    Lexer lex = { .vl = vl, .err = err, .origin = src_sv.data };
+    String_View src = sv_trim(src_sv);
+    
+    Token tk;
+    while (src.count != 0 && lex_scan(&lex, &src, &tk)) {
         lex_push(&lex, tk);
     }
 
+    // Parser takes position of the end from here
+    lex.src = (String_View) { .data = src.data + src.count };
+    STATS_TIME_END(HIST_LEXER_NS, start);
     return lex;
 }
 
+Lexer lexer(String_View src_sv, Var_List *vl)
+{
+    return lexer_try(src_sv, vl, NULL);
+}
+
+Lexer lexer_stream_try(String_View src_sv, Var_List *vl, Expr_Error *err)
+{
+    if (err != NULL) err->status = EXPR_OK;
+    return (Lexer) {
+        .vl = vl,
+        .err = err,
+        .origin = src_sv.data,
+        .stream = 1,
+        .src = sv_trim(src_sv),
+    };
+}
+
+Lexer lexer_stream(String_View src_sv, Var_List *vl)
+{
+    return lexer_stream_try(src_sv, vl, NULL);
+}
+
+// In stream mode `count` is number of tokens scanned so far,
+// only last LEX_RING of them are kept
+static Token *lex_at(Lexer *lex, size_t i)
+{
+    if (lex->stream) {
+        assert(i + LEX_RING >= lex->count && "token is out of lexer ring");
+        return &lex->ring[i % LEX_RING];
+    }
+    return &lex->items[i];
+}
+
+// Returns 0 if there are no more tokens
+static int lex_fill(Lexer *lex)
+{
+    if (lex->tp < lex->count) return 1;
+    if (!lex->stream || lex->src.count == 0) return 0;
+
+    // After an error the rest of the source is dropped, parser sees the end
+    if (!lex_scan(lex, &lex->src, &lex->ring[lex->count % LEX_RING])) {
+        lex->src.count = 0;
+        return 0;
+    }
+    lex->count += 1;
+    return 1;
+}
+
 Token token_next(Lexer *lex)
 {
-    if (lex->tp >= lex->count) {
+    if (!lex_fill(lex)) {
         return (Token) { .type = TYPE_NONE };
     } else {
-        Token tk = lex->items[lex->tp];
+        Token tk = *lex_at(lex, lex->tp);
         lex->tp += 1;
         return tk;
     }
@@ -97,10 +210,10 @@ Token token_next(Lexer *lex)
 
 Token_Type token_peek(Lexer *lex)
 {
-    if (lex->tp >= lex->count) {
+    if (!lex_fill(lex)) {
         return TYPE_NONE;
     } else {
-        Token_Type type = lex->items[lex->tp].type;
+        Token_Type type = lex_at(lex, lex->tp)->type;
         return type;
     }
 }
@@ -116,6 +229,10 @@ void print_token(Token tk)
             }
             break;
         }
+        case TYPE_VARIABLE: {
+            printf("var: `#%zu`\n", tk.var);
+            break;
+        }
         case TYPE_OPERATOR: {
             printf("opr: `%c`\n", tk.op);
             break;
@@ -138,8 +255,12 @@ void print_token(Token tk)
 void print_lex(Lexer *lex)
 {
     printf("\n-------------- LEXER --------------\n\n");
-    for (size_t i = 0; i < lex->count; ++i) {
-        print_token(lex->items[i]);
+    if (lex->stream) {
+        printf("stream: tokens are scanned on demand\n");
+    } else {
+        for (size_t i = 0; i < lex->count; ++i) {
+            print_token(lex->items[i]);
+        }
     }
     printf("\n-----------------------------------\n\n");
 }
\ No newline at end of file
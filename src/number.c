@@ -0,0 +1,114 @@
+#include "../include/number.h"
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#   define NUMBER_SWAR
+#endif
+
+#ifdef NUMBER_SWAR
+
+// All 8 bytes are in '0'..'9'
+static int number_is_eight_digits(uint64_t chunk)
+{
+    return ((chunk & 0xF0F0F0F0F0F0F0F0ULL) |
+            (((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) == 0x3333333333333333ULL;
+}
+
+// Convert 8 digits in 3 multiplications instead of 8
+static uint64_t number_eight_digits(uint64_t chunk)
+{
+    const uint64_t mask = 0x000000FF000000FFULL;
+    const uint64_t mul1 = 100 + (1000000ULL << 32);
+    const uint64_t mul2 = 1 + (10000ULL << 32);
+
+    chunk -= 0x3030303030303030ULL;
+    chunk = (chunk * 10) + (chunk >> 8);
+    chunk = (((chunk & mask) * mul1) + (((chunk >> 16) & mask) * mul2)) >> 32;
+    return chunk;
+}
+
+#endif // NUMBER_SWAR
+
+// Accumulate digits from the front of `s` into `m`, stops at first non digit.
+// Sets `overflow` if number does not fit into 64 bits
+static size_t number_digits(const char *s, size_t n, uint64_t *m, int *overflow)
+{
+    size_t i = 0;
+
+#ifdef NUMBER_SWAR
+    while (i + 8 <= n) {
+        uint64_t chunk;
+        memcpy(&chunk, s + i, 8);
+        if (!number_is_eight_digits(chunk)) break;
+
+        uint64_t d = number_eight_digits(chunk);
+        if (*m > (UINT64_MAX - d) / 100000000ULL) *overflow = 1;
+        *m = *m * 100000000ULL + d;
+        i += 8;
+    }
+#endif
+
+    for (; i < n && isdigit(s[i]); ++i) {
+        uint64_t d = s[i] - '0';
+        if (*m > (UINT64_MAX - d) / 10) *overflow = 1;
+        *m = *m * 10 + d;
+    }
+
+    return i;
+}
+
+int number_parse_i64(String_View sv, i64_t *out)
+{
+    uint64_t m = 0;
+    int overflow = 0;
+    size_t n = number_digits(sv.data, sv.count, &m, &overflow);
+
+    if (n == 0 || n != sv.count || overflow || m > (uint64_t) INT64_MAX) return 0;
+
+    *out = (i64_t) m;
+    return 1;
+}
+
+// Powers of ten which are exact in double
+static const double number_pow10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+#define NUMBER_BUF_SIZE 64
+
+int number_parse_f64(String_View sv, double *out)
+{
+    uint64_t m = 0;
+    int overflow = 0;
+
+    size_t n = number_digits(sv.data, sv.count, &m, &overflow);
+    if (n == 0) return 0;
+
+    size_t frac = 0;
+    if (n < sv.count && sv.data[n] == '.') {
+        frac = number_digits(sv.data + n + 1, sv.count - n - 1, &m, &overflow);
+        n += frac + 1;
+    }
+    if (n != sv.count) return 0;
+
+    // Mantissa and power of ten are both exact, so one division
+    // gives correctly rounded result (Clinger fast path)
+    if (!overflow && m <= (1ULL << 53) && frac <= 22) {
+        *out = (double) m / number_pow10[frac];
+        return 1;
+    }
+
+    // Long literals go through strtod, copy is on stack unless literal is huge
+    char buf[NUMBER_BUF_SIZE];
+    char *cstr = sv.count < NUMBER_BUF_SIZE ? buf : malloc(sv.count + 1);
+    assert(cstr != NULL);
+    memcpy(cstr, sv.data, sv.count);
+    cstr[sv.count] = '\0';
+
+    char *end;
+    *out = strtod(cstr, &end);
+    int ok = end == cstr + sv.count;
+
+    if (cstr != buf) free(cstr);
+    return ok;
+}
@@ -5,29 +5,47 @@ void print_node(Ast_Node *node)
     print_token(node->token);
 }
 
+typedef struct {
+    Ast_Node *node;
+    int indent;
+    const char *label;
+} Print_Item;
+
+typedef struct {
+    Print_Item *items;
+    size_t count;
+    size_t capacity;
+} Print_Stack;
+
+// Right child is printed before left one, as it was with recursion
 void print_ast_root(Ast_Node *node)
 {
-    static int i;
+    if (node == NULL) return;
 
-    TAB(i);
-    print_node(node);
+    Print_Stack stack = {0};
+    da_append(&stack, ((Print_Item) { .node = node, .indent = 0, .label = NULL }));
 
-    if (node->right_operand != NULL) {
-        TAB(i);
-        printf("right: ");
-        print_ast_root(node->right_operand);
-        i--;
-    }
+    while (stack.count > 0) {
+        Print_Item it = stack.items[--stack.count];
+        int i = it.indent;
 
-    if (node->left_operand != NULL) {
+        if (it.label != NULL) {
+            TAB(i);
+            printf("%s", it.label);
+        }
         TAB(i);
-        printf("left: ");
-        print_ast_root(node->left_operand);
-        i--;
+        print_node(it.node);
+
+        if (it.node->left_operand != NULL) {
+            da_append(&stack, ((Print_Item) { .node = it.node->left_operand, .indent = i, .label = "left: " }));
+        }
+        if (it.node->right_operand != NULL) {
+            da_append(&stack, ((Print_Item) { .node = it.node->right_operand, .indent = i, .label = "right: " }));
+        }
     }
 
-    i--;
-}          
+    da_clean(&stack);
+}
 
 void print_ast(Ast *ast)
 {
@@ -36,103 +54,186 @@ void print_ast(Ast *ast)
     printf("\n------------------------------------------------------------\n\n");
 }
 
-Ast_Node *resolve_ast(Ast_Node *node)
-{   
-    if (node->left_operand != NULL && node->right_operand != NULL) {
-        if (node->right_operand->token.type == TYPE_OPERATOR ||
-            node->left_operand->token.type == TYPE_OPERATOR ) {
-                node->left_operand = resolve_ast(node->left_operand);
-                node->right_operand = resolve_ast(node->right_operand);
+// Nodes are popped as root, right, left, so reversed output is post-order
+void ast_post_order(Ast_Node *root, Node_Stack *order, Node_Stack *stack)
+{
+    order->count = 0;
+    stack->count = 0;
+    if (root == NULL) return;
+
+    da_append(stack, root);
+    while (stack->count > 0) {
+        Ast_Node *node = stack->items[--stack->count];
+        da_append(order, node);
+        if (node->left_operand != NULL) da_append(stack, node->left_operand);
+        if (node->right_operand != NULL) da_append(stack, node->right_operand);
+    }
+
+    for (size_t i = 0, j = order->count - 1; i < j; ++i, --j) {
+        Ast_Node *tmp = order->items[i];
+        order->items[i] = order->items[j];
+        order->items[j] = tmp;
+    }
+}
+
+// Post-order of the whole tree. Parser fills it while building,
+// so it is only walked here for trees made by hand
+Node_Stack *ast_order(Ast *ast)
+{
+    if (ast->order.count == 0 && ast->root != NULL) {
+        ast_post_order(ast->root, &ast->order, &ast->nodes);
+    }
+    return &ast->order;
+}
+
+// Children come before parents in `order`, so one pass folds everything
+static void ast_fold(const Var_List *vl, Node_Stack *order)
+{
+    for (size_t i = 0; i < order->count; ++i) {
+        Ast_Node *node = order->items[i];
+
+        if (node->token.type == TYPE_VARIABLE) {
+            node->token = (Token) { .type = TYPE_VALUE, .val = vl->items[node->token.var].val };
+            continue;
         }
-            
-        if (node->token.type == TYPE_OPERATOR) {
-            char type;
-            Ast_Node *new_node = ast_node_create((Token) {.type = TYPE_VALUE });
-            if (node->left_operand->token.val.type == VAL_FLOAT) {
-                type = 'f'; 
-                new_node->token.val.type = VAL_FLOAT;
-            } else {
-                type = 'i'; 
-                new_node->token.val.type = VAL_INT;
-            } 
-
-            switch (node->token.op) {
-                case '+': BINARY_OP(new_node, +, node->left_operand, node->right_operand, type); break;
-                case '*': BINARY_OP(new_node, *, node->left_operand, node->right_operand, type); break;
-                case '-': BINARY_OP(new_node, -, node->left_operand, node->right_operand, type); break;
-                case '/': BINARY_OP(new_node, /, node->left_operand, node->right_operand, type); break;
-                default: {
-                    fprintf(stderr, "Error, unknown operator `%c`\n", node->token.op);
-                    EXIT;
-                }
+        if (node->token.type != TYPE_OPERATOR) continue;
+
+        Value a = node->left_operand->token.val;
+        Value b = node->right_operand->token.val;
+        Value result;
+
+        switch (node->token.op) {
+            case '+': VALUE_BINARY_OP(result, +, a, b); break;
+            case '*': VALUE_BINARY_OP(result, *, a, b); break;
+            case '-': VALUE_BINARY_OP(result, -, a, b); break;
+            case '/': VALUE_BINARY_OP(result, /, a, b); break;
+            default: {
+                fprintf(stderr, "Error, unknown operator `%c`\n", node->token.op);
+                EXIT;
             }
-
-            free(node->left_operand);
-            free(node->right_operand);
-            free(node);
-            return new_node;
         }
+
+        node->token = (Token) { .type = TYPE_VALUE, .val = result };
+        node->left_operand = NULL;
+        node->right_operand = NULL;
     }
+}
+
+// Fold the tree in place: operator and variable nodes become value nodes.
+// Children stay in the arena until `ast_reset` or `ast_clean`
+Ast_Node *resolve_ast(const Var_List *vl, Ast_Node *node)
+{
+    Node_Stack order = {0};
+    Node_Stack stack = {0};
+
+    ast_post_order(node, &order, &stack);
+    ast_fold(vl, &order);
+
+    da_clean(&order);
+    da_clean(&stack);
     return node;
 }
 
 // Get ast and calculate final number
 void eval(Ast *ast)
 {
-    ast->root = resolve_ast(ast->root);
-    ast->count = 1; 
+    STATS_TIME_BEGIN(start);
+    Node_Stack *order = ast_order(ast);
+    ast_fold(ast->vl, order);
+
+    order->items[0] = ast->root;
+    order->count = 1;
+    ast->count = 1;
+    STATS_TIME_END(HIST_EVAL_NS, start);
 }
 
-void ast_clean(Ast_Node *node, size_t *node_count)
+// Same as `eval`, but tree stays untouched. Post-order is run as RPN
+// on a value stack kept in ast, so after first call nothing is allocated.
+// Tree without nodes, e.g. after a failed `parser_try`, is 0
+Value ast_eval(Ast *ast)
 {
-    if (*node_count == 1) free(node);
-    else {
-        if (node->token.type == TYPE_OPERATOR) {
-            if (node->left_operand->token.type == TYPE_VALUE && 
-                node->right_operand->token.type == TYPE_VALUE) {
-                free(node->right_operand);
-                free(node->left_operand);
-                *node_count -= 2; 
+    STATS_TIME_BEGIN(start);
+    const Node_Stack *order = ast_order(ast);
+    const Var_List *vl = ast->vl;
+    Value_Stack *vs = &ast->values;
+
+    if (vs->capacity < order->count + 1) {
+        vs->capacity = order->count + 1;
+        vs->items = realloc(vs->items, vs->capacity * sizeof(*vs->items));
+        assert(vs->items != NULL);
+    }
+
+    Value *sp = vs->items;
+    for (size_t i = 0; i < order->count; ++i) {
+        const Ast_Node *node = order->items[i];
+
+        switch (node->token.type) {
+            case TYPE_VALUE: *sp++ = node->token.val; break;
+            case TYPE_VARIABLE: *sp++ = vl->items[node->token.var].val; break;
+            default: {
+                switch (node->token.op) {
+                    case '+': VALUE_BINARY_OP(sp[-2], +, sp[-2], sp[-1]); break;
+                    case '*': VALUE_BINARY_OP(sp[-2], *, sp[-2], sp[-1]); break;
+                    case '-': VALUE_BINARY_OP(sp[-2], -, sp[-2], sp[-1]); break;
+                    case '/': VALUE_BINARY_OP(sp[-2], /, sp[-2], sp[-1]); break;
+                    default: {
+                        fprintf(stderr, "Error, unknown operator `%c`\n", node->token.op);
+                        EXIT;
+                    }
+                }
+                sp--;
             }
-        } else if (node->token.type == TYPE_VALUE) { 
-            return;
-        } else {
-            ast_clean(node->left_operand, node_count);
-            ast_clean(node->right_operand, node_count);
         }
     }
+
+    STATS_TIME_END(HIST_EVAL_NS, start);
+    return order->count > 0 ? vs->items[0] : VALUE_INT(0);
+}
+
+// Drop all nodes but keep arena memory for the next expression
+void ast_reset(Ast *ast)
+{
+    arena_reset(&ast->arena);
+    ast->root = NULL;
+    ast->count = 0;
+    ast->order.count = 0;
 }
 
-Ast_Node *ast_node_create(Token tk)
+void ast_clean(Ast *ast)
 {
-    Ast_Node *node = malloc(sizeof(Ast_Node));
+    arena_free(&ast->arena);
+    da_clean(&ast->nodes);
+    da_clean(&ast->ops);
+    da_clean(&ast->order);
+    da_clean(&ast->values);
+    ast->root = NULL;
+    ast->count = 0;
+}
+
+Ast_Node *ast_node_create(Arena *arena, Token tk)
+{
+    Ast_Node *node = arena_alloc(arena, sizeof(Ast_Node));
+    STATS_ADD(STAT_NODES, 1);
+    STATS_ADD(STAT_NODE_BYTES, sizeof(Ast_Node));
     node->token = tk;
     node->left_operand = NULL;
     node->right_operand = NULL;
     return node;
 }
 
-void ast_push_subtree(Ast *ast, Ast_Node *subtree)
-{
-    if (ast->root == NULL) {
-        ast->root = subtree;
-    } else {
-        if (subtree->right_operand != NULL) {
-            subtree->left_operand = ast->root;
-            ast->root = subtree;
-        } else {
-            subtree->right_operand = ast->root;
-            ast->root = subtree;
-        }
-    }
-}
-
 void subtree_node_count(Ast_Node *subtree, size_t *count) 
 {
     if (subtree == NULL) return;
-    subtree_node_count(subtree->left_operand, count);
-    *count += 1;
-    subtree_node_count(subtree->right_operand, count);
+
+    Node_Stack stack = {0};
+    da_append(&stack, subtree);
+    while (stack.count > 0) {
+        Ast_Node *node = stack.items[--stack.count];
+        *count += 1;
+        if (node->left_operand != NULL) da_append(&stack, node->left_operand);
+        if (node->right_operand != NULL) da_append(&stack, node->right_operand);
+    }
+    da_clean(&stack);
 }
 
 /*
@@ -146,279 +247,145 @@ void subtree_node_count(Ast_Node *subtree, size_t *count)
 *   
 *   E: T { + | -  T }*
 *   T: V { * | /  V }*
-*   V: INT | FLOAT
+*   V: INT | FLOAT | VAR | ( E )
+*
+*  Parsed by shunting-yard with explicit stacks, so every token is pushed
+*  and popped at most once and nesting depth does not touch the C stack
 */
 
-
-Ast_Node *parse_expr(Token tk, Lexer *lex)
+static void parser_reduce(Ast *ast)
 {
-    if (tk.type == TYPE_VALUE) {
-        Ast_Node *val1;
-        Ast_Node *opr;
-        Ast_Node *val2;
-
-        val1 = parse_term(tk, lex);
-        Token_Type type;
-
-        do {
-            type = token_peek(lex);
-            if (type == TYPE_OPERATOR) {
-                Token _op = token_next(lex);
-                if (_op.op == '+' || _op.op == '-') {
-                    opr = ast_node_create(_op);
-
-                    Token v2 = token_next(lex);
-                    
-                    if (v2.type == TYPE_OPEN_BRACKET) {
-                        Token t1 = token_next(lex);
-                        val2 = parse_expr(t1, lex);
-
-                        do {
-                            Token opr_tk = token_next(lex);
-                            if (opr_tk.type == TYPE_OPERATOR) {
-                                if (opr_tk.op == '*' || opr_tk.op == '/') {
-                                    Ast_Node *opr_node = ast_node_create(opr_tk);
-                                    Ast_Node *subval;
-
-                                    Token tok = token_next(lex);
-                                    if (tok.type == TYPE_VALUE) {
-                                        subval = parse_term(tok, lex);
-
-                                    } else if (tok.type == TYPE_OPEN_BRACKET) {
-                                        tok = token_next(lex);
-                                        subval = parse_expr(tok, lex);
-                                    }
-
-                                    opr_node->left_operand = val2;
-                                    opr_node->right_operand = subval;
-                                    val2 = opr_node;
-
-                                } else {
-                                    lex->tp -= 1;
-                                    break;
-                                }
-                            } else {
-                                lex->tp -= 1;
-                                break;
-                            }
-                        } while(1);
-
-                    } else if (v2.type == TYPE_VALUE) {
-                        val2 = parse_term(v2, lex);
-
-                    } else {
-                        fprintf(stderr, "Error: in function `parse_expr` unknown condition\n");
-                        EXIT;
-                    }
-
-                    if (val2 == NULL) EXIT;
-                    
-                    opr->left_operand = val1;
-                    opr->right_operand = val2;
-                    val1 = opr;
-                }
-            } else if (type == TYPE_OPEN_BRACKET) {
-                Token t1 = token_next(lex);
-                Ast_Node *subtree = parse_expr(t1, lex);
-                
-                if (subtree == NULL) EXIT;
-                return subtree;
-
-            } else if (type == TYPE_NONE) {
-                return val1;
-
-            } else if (type == TYPE_CLOSE_BRACKET) {
-                token_next(lex);
-                return val1;
-
-            } else {
-                fprintf(stderr, "Error: in `parse_expr` unknown token type `%u`\n", type);
-                print_token(lex->items[lex->tp]);
-                printf("tp: %zu\n", lex->tp);
-                printf("count: %zu\n", lex->count);
-                EXIT;
-            }
-        } while(1); 
-
-        return val1;
-
-    } else if (tk.type == TYPE_OPEN_BRACKET) {
-        Token_Type type;
-        Token t1 = token_next(lex);
-        Ast_Node *subtree = parse_expr(t1, lex);
-
-        do {
-            type = token_peek(lex);
-            if (type == TYPE_OPERATOR) {
-                Ast_Node *val;
-                Token opr_tk = token_next(lex);
-                Ast_Node *opr_node = ast_node_create(opr_tk);
-
-                Token tk2 = token_next(lex);
-                if (tk2.type == TYPE_OPEN_BRACKET) {
-                    Token tk3 = token_next(lex);
-                    val = parse_expr(tk3, lex);
-                    
-                    if (val == NULL) EXIT;
-
-                    Token t2 = token_next(lex);
-                    if (t2.type == TYPE_OPERATOR) {
-                        Ast_Node *subval;
-                        Ast_Node *op_node = ast_node_create(t2);
-
-                        Token t3 = token_next(lex);
-                        if (t3.type == TYPE_OPEN_BRACKET) {
-                            Token t4 = token_next(lex);
-                            subval = parse_expr(t4, lex);
-
-                            if (subval == NULL) EXIT;
-
-                        } else if (t3.type == TYPE_VALUE) {
-                            subval = parse_term(t3, lex);
-                        }
-
-                        op_node->left_operand = val;
-                        op_node->right_operand = subval;
-                        val = op_node;
-
-                    } else {
-                        lex->tp -= 1;
-                    }
-
-                } else if (tk2.type == TYPE_VALUE) {
-                    val = parse_term(tk2, lex);
-                }
+    Token op = ast->ops.items[--ast->ops.count];
+    Ast_Node *right = ast->nodes.items[--ast->nodes.count];
+    Ast_Node *left = ast->nodes.items[--ast->nodes.count];
 
-                opr_node->left_operand = subtree;
-                opr_node->right_operand = val;
-                subtree = opr_node;
+    Ast_Node *node = ast_node_create(&ast->arena, op);
+    node->left_operand = left;
+    node->right_operand = right;
+    da_append(&ast->order, node);
+    ast->count += 1;
 
-            } else if (type == TYPE_CLOSE_BRACKET) {
-                token_next(lex);
-            } else {
-                break;
-            }
-        } while (1);
-
-        return subtree;
-        
-    } else {
-        fprintf(stderr, "Error: unknown type in function `parse_expr` in 1st condition\n");
-        return NULL;
-    }
+    ast->nodes.items[ast->nodes.count++] = node;
 }
 
-Ast_Node *parse_term(Token tk, Lexer *lex)
-{   
-    Ast_Node *val1 = ast_node_create(tk);  
-
-    do {
-        Token_Type tk_type = token_peek(lex);
-        if (tk_type == TYPE_NONE) break;
+// Offset of the end of the source, where a missing token was expected
+static size_t parser_end(const Lexer *lex)
+{
+    return lex->src.data != NULL ? (size_t) (lex->src.data + lex->src.count - lex->origin) : 0;
+}
 
-        if (tk_type == TYPE_OPERATOR) {
-            Ast_Node *val2;
-            Token opr_tk = token_next(lex);
+// On error everything allocated for this expression is given back,
+// nodes of previous expressions in the same ast stay as they were
+Expr_Status parser_try(Ast *ast, Lexer *lex, Expr_Error *err)
+{
+    STATS_TIME_BEGIN(start);
+    Arena_Mark mark = arena_mark(&ast->arena);
+    size_t count = ast->count;
 
-            if (opr_tk.op == '*' || opr_tk.op == '/') {
-                Ast_Node *opr_node = ast_node_create(opr_tk);
-                Token t1 = token_next(lex);
+    lex->err = err;
+    ast->vl = lex->vl;
+    ast->nodes.count = 0;
+    ast->ops.count = 0;
+    ast->order.count = 0;
 
-                if (t1.type == TYPE_VALUE) {
-                    val2 = ast_node_create(t1);
+    // Eager lexer has already stopped at a bad token
+    if (err != NULL && err->status != EXPR_OK) goto fail;
 
-                } else if (t1.type == TYPE_OPEN_BRACKET) {
-                    Token tok = token_next(lex); 
-                    val2 = parse_expr(tok, lex);
-            
-                } else if (t1.type == TYPE_NONE) {
-                    fprintf(stderr, "Error: expected second operand\n");
-                    EXIT;
-                }
+    int expect_operand = 1;
+    while (1) {
+        Token tk = token_next(lex);
+        if (tk.type == TYPE_NONE) break;
 
-                if (val2 == NULL) EXIT;
+        if (expect_operand) {
+            if (TOKEN_IS_OPERAND(tk.type)) {
+                Ast_Node *node = ast_node_create(&ast->arena, tk);
+                da_append(&ast->nodes, node);
+                da_append(&ast->order, node);
+                ast->count += 1;
+                expect_operand = 0;
 
-                opr_node->left_operand = val1;
-                opr_node->right_operand = val2;
-                val1 = opr_node;
+            } else if (tk.type == TYPE_OPEN_BRACKET) {
+                da_append(&ast->ops, tk);
 
             } else {
-                lex->tp -= 1;
-                break;
+                expr_error(err, EXPR_ERR_SYNTAX, tk.pos, "expected value or `(`, got `%c`", tk.op);
+                goto fail;
             }
-        } else {
-            break;
-        }
-    } while (1);
 
-    return val1;
-}
+        } else {
+            if (tk.type == TYPE_OPERATOR) {
+                uint8_t prec = op_prec[(unsigned char) tk.op];
+                if (prec == 0) {
+                    expr_error(err, EXPR_ERR_OPERATOR, tk.pos, "unknown operator `%c`", tk.op);
+                    goto fail;
+                }
 
-void parser(Ast *ast, Lexer *lex)
-{
-    while (1) {
-        Token tk = token_next(lex);
-        if (tk.type == TYPE_NONE) break;
-        
-        size_t count = 0;
-        if (tk.type == TYPE_VALUE) {
-            Token_Type type = token_peek(lex);
-            if (type == TYPE_OPERATOR) {
-                Token t1 = token_next(lex);
-                if (t1.op == '+' || t1.op == '-') {
-                    lex->tp -= 1;
-
-                    Ast_Node *subtree = parse_expr(tk, lex);
-                    if (subtree == NULL) EXIT;
-
-                    subtree_node_count(subtree, &count);
-                    ast_push_subtree(ast, subtree);
-
-                } else if (t1.op == '*' || t1.op == '/') {
-                    lex->tp -= 1;
-                    Ast_Node *val = parse_term(tk, lex);
-
-                    subtree_node_count(val, &count);
-                    ast_push_subtree(ast, val);
+                // All operators are left associative
+                while (ast->ops.count > 0) {
+                    Token top = ast->ops.items[ast->ops.count - 1];
+                    if (top.type != TYPE_OPERATOR || op_prec[(unsigned char) top.op] < prec) break;
+                    parser_reduce(ast);
                 }
-            }
 
-        } else if (tk.type == TYPE_OPERATOR) {
-            Ast_Node *val;
-            Ast_Node *opr = ast_node_create(tk);
-            Token tok = token_next(lex);
+                da_append(&ast->ops, tk);
+                expect_operand = 1;
 
-            if (tok.type == TYPE_VALUE) {
-                val = parse_term(tok, lex);
-            
-            } else if (tok.type == TYPE_OPEN_BRACKET) {
-                Token t = token_next(lex);
-                val = parse_expr(t, lex);    
-                if (val == NULL) EXIT;
+            } else if (tk.type == TYPE_CLOSE_BRACKET) {
+                while (ast->ops.count > 0 && ast->ops.items[ast->ops.count - 1].type == TYPE_OPERATOR) {
+                    parser_reduce(ast);
+                }
+                if (ast->ops.count == 0) {
+                    expr_error(err, EXPR_ERR_SYNTAX, tk.pos, "unexpected `)`");
+                    goto fail;
+                }
+                ast->ops.count -= 1;
 
             } else {
-                fprintf(stderr, "Error: in function `parser` unknown condition\n");
-                EXIT;
+                expr_error(err, EXPR_ERR_SYNTAX, tk.pos, "expected operator or `)`");
+                goto fail;
             }
+        }
+    }
 
-            count += 1; // its `opr`
-            subtree_node_count(val, &count);
+    // Stream lexer ends the input on a bad token
+    if (err != NULL && err->status != EXPR_OK) goto fail;
 
-            opr->right_operand = val;
-            ast_push_subtree(ast, opr);
+    if (expect_operand) {
+        expr_error(err, EXPR_ERR_SYNTAX, parser_end(lex), "unexpected end of expression");
+        goto fail;
+    }
 
-        } else if (tk.type == TYPE_OPEN_BRACKET) {
-            Token tok = token_next(lex);
-            Ast_Node *subtree = parse_expr(tok, lex);
-            if (subtree == NULL) EXIT;
+    while (ast->ops.count > 0) {
+        Token top = ast->ops.items[ast->ops.count - 1];
+        if (top.type != TYPE_OPERATOR) {
+            expr_error(err, EXPR_ERR_SYNTAX, top.pos, "expected `)` for this `(`");
+            goto fail;
+        }
+        parser_reduce(ast);
+    }
 
-            subtree_node_count(subtree, &count);
-            ast_push_subtree(ast, subtree);
+    ast->root = ast->nodes.items[0];
+    STATS_TIME_END(HIST_PARSER_NS, start);
+    return EXPR_OK;
+
+fail:
+    arena_rewind(&ast->arena, mark);
+    ast->root = NULL;
+    ast->count = count;
+    ast->nodes.count = 0;
+    ast->ops.count = 0;
+    ast->order.count = 0;
+    return err->status;
+}
 
-        } else if (tk.type == TYPE_CLOSE_BRACKET) {
-            token_next(lex);
-        }
+// Errors go to the context of the lexer, exit if it has none
+void parser(Ast *ast, Lexer *lex)
+{
+    parser_try(ast, lex, lex->err);
+}
 
-        ast->count += count;
-    }
-}
\ No newline at end of file
+Expr_Status expr_parse(Ast *ast, String_View src, Var_List *vl, Expr_Error *err)
+{
+    Lexer lex = lexer_stream_try(src, vl, err);
+    return parser_try(ast, &lex, err);
+}
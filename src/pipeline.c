@@ -0,0 +1,112 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#include "../include/pipeline.h"
+
+// Every worker owns a range of expressions and takes chunks from its front.
+// When own range is empty worker steals chunks from ranges of others,
+// so cheap and expensive expressions even out between threads
+typedef struct {
+    _Alignas(64) atomic_size_t next;
+    size_t end;
+} Pipeline_Range;
+
+typedef struct {
+    String_View *exprs;
+    Var_List *vl;
+    Value *results;
+    Expr_Status *status;
+    Pipeline_Range *ranges;
+    size_t workers;
+} Pipeline;
+
+typedef struct {
+    Pipeline *p;
+    size_t id;
+} Pipeline_Worker;
+
+static int pipeline_take(Pipeline_Range *r, size_t *begin, size_t *end)
+{
+    size_t b = atomic_fetch_add_explicit(&r->next, PIPELINE_CHUNK, memory_order_relaxed);
+    if (b >= r->end) return 0;
+
+    *begin = b;
+    *end = b + PIPELINE_CHUNK < r->end ? b + PIPELINE_CHUNK : r->end;
+    return 1;
+}
+
+static void *pipeline_worker(void *arg)
+{
+    Pipeline_Worker *w = arg;
+    Pipeline *p = w->p;
+
+    // Each worker reuses its own arena and error for all of its expressions
+    Ast ast = {0};
+    Expr_Error err;
+    size_t begin, end;
+
+    for (size_t k = 0; k < p->workers; ++k) {
+        Pipeline_Range *r = &p->ranges[(w->id + k) % p->workers];
+        while (pipeline_take(r, &begin, &end)) {
+            for (size_t i = begin; i < end; ++i) {
+                p->status[i] = expr_parse(&ast, p->exprs[i], p->vl, &err);
+                p->results[i] = p->status[i] == EXPR_OK ? ast_eval(&ast) : VALUE_INT(0);
+                ast_reset(&ast);
+            }
+        }
+    }
+
+    ast_clean(&ast);
+    return NULL;
+}
+
+void pipeline_eval(String_View *exprs, size_t count, Var_List *vl, Value *results, Expr_Status *status, size_t threads)
+{
+    if (threads == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cores > 0 ? (size_t) cores : 1;
+    }
+
+    size_t chunks = (count + PIPELINE_CHUNK - 1) / PIPELINE_CHUNK;
+    if (threads > chunks) threads = chunks > 0 ? chunks : 1;
+
+    Pipeline p = {
+        .exprs = exprs,
+        .vl = vl,
+        .results = results,
+        .status = status,
+        .workers = threads,
+    };
+
+    p.ranges = aligned_alloc(_Alignof(Pipeline_Range), sizeof(Pipeline_Range) * threads);
+    Pipeline_Worker *workers = malloc(sizeof(Pipeline_Worker) * threads);
+    pthread_t *tids = malloc(sizeof(pthread_t) * threads);
+    assert(p.ranges != NULL && workers != NULL && tids != NULL);
+
+    // Ranges are split by whole chunks
+    for (size_t i = 0; i < threads; ++i) {
+        size_t begin = chunks * i / threads * PIPELINE_CHUNK;
+        size_t end = chunks * (i + 1) / threads * PIPELINE_CHUNK;
+        atomic_init(&p.ranges[i].next, begin < count ? begin : count);
+        p.ranges[i].end = end < count ? end : count;
+        workers[i] = (Pipeline_Worker) { .p = &p, .id = i };
+    }
+
+    // Calling thread is worker 0
+    for (size_t i = 1; i < threads; ++i) {
+        int err = pthread_create(&tids[i], NULL, pipeline_worker, &workers[i]);
+        if (err != 0) {
+            fprintf(stderr, "Error: cannot create thread: %s\n", strerror(err));
+            EXIT;
+        }
+    }
+    pipeline_worker(&workers[0]);
+    for (size_t i = 1; i < threads; ++i) {
+        pthread_join(tids[i], NULL);
+    }
+
+    free(p.ranges);
+    free(workers);
+    free(tids);
+}
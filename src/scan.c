@@ -0,0 +1,108 @@
+#include "../include/scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#   define SCAN_X86
+#   include <immintrin.h>
+#endif
+
+const uint8_t sv_class[256] = {
+    [' ']  = SV_SPACE,
+    ['\t'] = SV_SPACE,
+    ['\n'] = SV_SPACE,
+    ['\v'] = SV_SPACE,
+    ['\f'] = SV_SPACE,
+    ['\r'] = SV_SPACE,
+    ['0' ... '9'] = SV_DIGIT,
+    ['a' ... 'z'] = SV_ALPHA,
+    ['A' ... 'Z'] = SV_ALPHA,
+    ['+'] = SV_SPECIAL,
+    ['-'] = SV_SPECIAL,
+    ['*'] = SV_SPECIAL,
+    ['/'] = SV_SPECIAL,
+    ['%'] = SV_SPECIAL,
+    ['('] = SV_SPECIAL,
+    [')'] = SV_SPECIAL,
+    ['.'] = SV_DOT,
+};
+
+#define SCALAR_SPAN(name, cls)                                  \
+    static size_t name(const char *s, size_t n)                 \
+    {                                                           \
+        size_t i = 0;                                           \
+        while (i < n && SV_IS(s[i], cls)) i++;                  \
+        return i;                                               \
+    }
+
+SCALAR_SPAN(span_space_scalar, SV_SPACE)
+SCALAR_SPAN(span_value_scalar, SV_DIGIT | SV_DOT)
+SCALAR_SPAN(span_alpha_scalar, SV_ALPHA)
+
+#ifdef SCAN_X86
+
+// Whole vectors are classified while they fit into `n`, the tail goes by table.
+// Bytes >= 0x80 are negative for signed compares, so they never match a range
+#define SIMD_SPAN(name, isa, V, width, load, movemask, full, classify, cls)    \
+    __attribute__((target(isa)))                                                \
+    static size_t name(const char *s, size_t n)                                 \
+    {                                                                           \
+        size_t i = 0;                                                           \
+        for (; i + (width) <= n; i += (width)) {                                \
+            V c = load((const V *) (s + i));                                    \
+            uint32_t mask = (uint32_t) movemask(classify(c));                   \
+            if (mask != (full)) return i + __builtin_ctz(~mask);                \
+        }                                                                       \
+        while (i < n && SV_IS(s[i], cls)) i++;                                  \
+        return i;                                                               \
+    }
+
+#define SSE2_RANGE(c, lo, hi)                                                           \
+    _mm_and_si128(_mm_cmpgt_epi8((c), _mm_set1_epi8((lo) - 1)),                         \
+                  _mm_cmpgt_epi8(_mm_set1_epi8((hi) + 1), (c)))
+#define SSE2_SPACE(c) _mm_or_si128(_mm_cmpeq_epi8((c), _mm_set1_epi8(' ')), SSE2_RANGE(c, '\t', '\r'))
+#define SSE2_VALUE(c) _mm_or_si128(_mm_cmpeq_epi8((c), _mm_set1_epi8('.')), SSE2_RANGE(c, '0', '9'))
+#define SSE2_ALPHA(c) SSE2_RANGE(_mm_or_si128((c), _mm_set1_epi8(0x20)), 'a', 'z')
+
+#define AVX2_RANGE(c, lo, hi)                                                           \
+    _mm256_and_si256(_mm256_cmpgt_epi8((c), _mm256_set1_epi8((lo) - 1)),                \
+                     _mm256_cmpgt_epi8(_mm256_set1_epi8((hi) + 1), (c)))
+#define AVX2_SPACE(c) _mm256_or_si256(_mm256_cmpeq_epi8((c), _mm256_set1_epi8(' ')), AVX2_RANGE(c, '\t', '\r'))
+#define AVX2_VALUE(c) _mm256_or_si256(_mm256_cmpeq_epi8((c), _mm256_set1_epi8('.')), AVX2_RANGE(c, '0', '9'))
+#define AVX2_ALPHA(c) AVX2_RANGE(_mm256_or_si256((c), _mm256_set1_epi8(0x20)), 'a', 'z')
+
+SIMD_SPAN(span_space_sse2, "sse2", __m128i, 16, _mm_loadu_si128, _mm_movemask_epi8, 0xFFFFu, SSE2_SPACE, SV_SPACE)
+SIMD_SPAN(span_value_sse2, "sse2", __m128i, 16, _mm_loadu_si128, _mm_movemask_epi8, 0xFFFFu, SSE2_VALUE, SV_DIGIT | SV_DOT)
+SIMD_SPAN(span_alpha_sse2, "sse2", __m128i, 16, _mm_loadu_si128, _mm_movemask_epi8, 0xFFFFu, SSE2_ALPHA, SV_ALPHA)
+
+SIMD_SPAN(span_space_avx2, "avx2", __m256i, 32, _mm256_loadu_si256, _mm256_movemask_epi8, 0xFFFFFFFFu, AVX2_SPACE, SV_SPACE)
+SIMD_SPAN(span_value_avx2, "avx2", __m256i, 32, _mm256_loadu_si256, _mm256_movemask_epi8, 0xFFFFFFFFu, AVX2_VALUE, SV_DIGIT | SV_DOT)
+SIMD_SPAN(span_alpha_avx2, "avx2", __m256i, 32, _mm256_loadu_si256, _mm256_movemask_epi8, 0xFFFFFFFFu, AVX2_ALPHA, SV_ALPHA)
+
+#endif // SCAN_X86
+
+typedef size_t (*Span_Func)(const char *s, size_t n);
+
+static Span_Func span_space = span_space_scalar;
+static Span_Func span_value = span_value_scalar;
+static Span_Func span_alpha = span_alpha_scalar;
+
+// Chosen once before main, so spans are never called with half set pointers
+__attribute__((constructor))
+static void scan_init(void)
+{
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        span_space = span_space_avx2;
+        span_value = span_value_avx2;
+        span_alpha = span_alpha_avx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        span_space = span_space_sse2;
+        span_value = span_value_sse2;
+        span_alpha = span_alpha_sse2;
+    }
+#endif
+}
+
+size_t sv_span_space(const char *s, size_t n) { return span_space(s, n); }
+size_t sv_span_value(const char *s, size_t n) { return span_value(s, n); }
+size_t sv_span_alpha(const char *s, size_t n) { return span_alpha(s, n); }
@@ -0,0 +1,101 @@
+#include <time.h>
+
+#include "../include/stats.h"
+
+static Stats stats;
+
+const char *stats_counter_names[STAT_COUNT] = {
+    [STAT_TOKENS]      = "tokens",
+    [STAT_NODES]       = "nodes",
+    [STAT_NODE_BYTES]  = "node_bytes",
+    [STAT_DA_BYTES]    = "da_bytes",
+    [STAT_VAR_LOOKUPS] = "var_lookups",
+    [STAT_VAR_PROBES]  = "var_probes",
+};
+
+const char *stats_hist_names[HIST_COUNT] = {
+    [HIST_LEXER_NS]  = "lexer_ns",
+    [HIST_PARSER_NS] = "parser_ns",
+    [HIST_EVAL_NS]   = "eval_ns",
+    [HIST_VAR_PROBE] = "var_probe",
+};
+
+uint64_t stats_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+void stats_add(Stat_Counter counter, uint64_t n)
+{
+    __atomic_fetch_add(&stats.counters[counter], n, __ATOMIC_RELAXED);
+}
+
+void stats_hist_add(Stat_Hist hist, uint64_t value)
+{
+    Stats_Hist *h = &stats.hists[hist];
+    size_t bucket = value == 0 ? 0 : 64 - __builtin_clzll(value);
+
+    __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->sum, value, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->buckets[bucket], 1, __ATOMIC_RELAXED);
+
+    uint64_t max = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+    while (value > max &&
+           !__atomic_compare_exchange_n(&h->max, &max, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+// Fields are read one by one, so snapshot taken during updates
+// may be slightly inconsistent between counters
+void stats_get(Stats *out)
+{
+    uint64_t *src = (uint64_t *) &stats;
+    uint64_t *dst = (uint64_t *) out;
+    for (size_t i = 0; i < sizeof(Stats) / sizeof(uint64_t); ++i) {
+        dst[i] = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+    }
+}
+
+void stats_reset(void)
+{
+    uint64_t *dst = (uint64_t *) &stats;
+    for (size_t i = 0; i < sizeof(Stats) / sizeof(uint64_t); ++i) {
+        __atomic_store_n(&dst[i], 0, __ATOMIC_RELAXED);
+    }
+}
+
+// Only non empty buckets are written as [low bound, count]
+void stats_dump_json(FILE *f)
+{
+    Stats s;
+    stats_get(&s);
+
+#ifdef STATS_ENABLE
+    fprintf(f, "{\n  \"enabled\": true,\n  \"counters\": {");
+#else
+    fprintf(f, "{\n  \"enabled\": false,\n  \"counters\": {");
+#endif
+    for (size_t i = 0; i < STAT_COUNT; ++i) {
+        fprintf(f, "%s\n    \"%s\": %llu", i > 0 ? "," : "", stats_counter_names[i],
+                (unsigned long long) s.counters[i]);
+    }
+    fprintf(f, "\n  },\n  \"histograms\": {");
+
+    for (size_t i = 0; i < HIST_COUNT; ++i) {
+        Stats_Hist *h = &s.hists[i];
+        fprintf(f, "%s\n    \"%s\": { \"count\": %llu, \"sum\": %llu, \"max\": %llu, \"buckets\": [",
+                i > 0 ? "," : "", stats_hist_names[i], (unsigned long long) h->count,
+                (unsigned long long) h->sum, (unsigned long long) h->max);
+
+        int first = 1;
+        for (size_t b = 0; b < STATS_BUCKETS; ++b) {
+            if (h->buckets[b] == 0) continue;
+            unsigned long long low = b == 0 ? 0 : 1ULL << (b - 1);
+            fprintf(f, "%s[%llu, %llu]", first ? "" : ", ", low, (unsigned long long) h->buckets[b]);
+            first = 0;
+        }
+        fprintf(f, "] }");
+    }
+    fprintf(f, "\n  }\n}\n");
+}
@@ -10,10 +10,7 @@ String_View sv_from_cstr(char *cstr)
 
 String_View sv_trim_left(String_View sv)
 {
-    size_t i = 0;
-    while (i < sv.count && isspace(sv.data[i])) {
-        i += 1;
-    }
+    size_t i = sv_span_space(sv.data, sv.count);
 
     return (String_View) {
         .count = sv.count - i,
@@ -24,7 +21,7 @@ String_View sv_trim_left(String_View sv)
 String_View sv_trim_right(String_View sv)
 {
     size_t i = 0;
-    while (i < sv.count && isspace(sv.data[sv.count - i - 1])) {
+    while (i < sv.count && SV_IS(sv.data[sv.count - i - 1], SV_SPACE)) {
         i += 1;
     }
 
@@ -41,10 +38,8 @@ String_View sv_trim(String_View sv)
 
 String_View sv_div_by_delim(String_View *sv, char delim)
 {
-    size_t i = 0;
-    while (i < sv->count && sv->data[i] != delim) {
-        i += 1;
-    }
+    const char *found = memchr(sv->data, delim, sv->count);
+    size_t i = found != NULL ? (size_t) (found - sv->data) : sv->count;
 
     String_View result = {
         .count = i,
@@ -71,6 +66,44 @@ int sv_cmp(String_View sv1, String_View sv2)
     }
 }
 
+// FNV-1a
+uint64_t sv_hash(String_View sv)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < sv.count; ++i) {
+        hash ^= (unsigned char) sv.data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Whitespace runs become one space, and are dropped at ends and next to
+// operators and brackets. `out` must have room for `src.count` chars
+size_t sv_normalize(String_View src, char *out)
+{
+    size_t n = 0;
+    size_t i = 0;
+    while (i < src.count) {
+        if (!SV_IS(src.data[i], SV_SPACE)) {
+            out[n++] = src.data[i++];
+            continue;
+        }
+
+        // Space matters only between two names or numbers. Single spaces
+        // are the common case, only longer runs go to the span
+        if (i + 1 < src.count && SV_IS(src.data[i + 1], SV_SPACE)) {
+            i += sv_span_space(src.data + i, src.count - i);
+        } else {
+            i += 1;
+        }
+        if (n > 0 && i < src.count &&
+            !SV_IS(out[n - 1], SV_SPECIAL) && !SV_IS(src.data[i], SV_SPECIAL)) {
+            out[n++] = ' ';
+        }
+    }
+    return n;
+}
+
 int sv_to_int(String_View sv)
 {
     int result = 0;
@@ -83,14 +116,7 @@ int sv_to_int(String_View sv)
 
 int sv_is_float(String_View sv)
 {
-    int res = 0;
-    for (size_t i = 0; i < sv.count; ++i) {
-        if (sv.data[i] == '.') {
-            res = 1;
-            break;
-        }
-    }
-    return res;
+    return memchr(sv.data, '.', sv.count) != NULL;
 }
 
 String_View sv_div_by_next_symbol(String_View *sv)
@@ -100,7 +126,7 @@ String_View sv_div_by_next_symbol(String_View *sv)
     size_t i = 0;
     size_t count = 0;
     while (i < sv->count) {
-        if (!isspace(sv->data[i])) {
+        if (!SV_IS(sv->data[i], SV_SPACE)) {
             count++;
         }
 
@@ -124,22 +150,12 @@ String_View sv_div_by_next_symbol(String_View *sv)
 
 int char_in_sv(String_View sv, char c)
 {   
-    int result = 0;
-    for (size_t i = 0; i < sv.count; ++i) {
-        if (sv.data[i] == c) {
-            result = 1;
-            break;
-        }
-    }
-    return result;
+    return memchr(sv.data, c, sv.count) != NULL;
 }
 
 void sv_cut_space_left(String_View *sv)
 {
-    size_t i = 0;
-    while (i < sv->count && isspace(sv->data[i])) {
-        i++;
-    }
+    size_t i = sv_span_space(sv->data, sv->count);
 
     sv->count -= i;
     sv->data += i;
@@ -154,10 +170,7 @@ void sv_cut_left(String_View *sv, int step)
 String_View sv_cut_value(String_View *sv)
 {
     String_View result;
-    size_t i = 0;
-    while (i < sv->count && (isdigit(sv->data[i]) || sv->data[i] == '.')) {
-        i++;
-    }
+    size_t i = sv_span_value(sv->data, sv->count);
 
     result.data = sv->data;
     result.count = i;
@@ -171,10 +184,7 @@ String_View sv_cut_value(String_View *sv)
 String_View sv_cut_part(String_View *sv)
 {
     String_View result;
-    size_t i = 0;
-    while (i < sv->count && isalpha(sv->data[i])) {
-        i++;
-    }
+    size_t i = sv_span_alpha(sv->data, sv->count);
 
     result.count = i;
     result.data = sv->data;
@@ -0,0 +1,238 @@
+#include "../include/typed.h"
+
+// Post-order is run as RPN over types only
+Value_Type ast_infer(Ast *ast, Type_Stack *types)
+{
+    const Node_Stack *order = ast_order(ast);
+    const Var_List *vl = ast->vl;
+    types->count = 0;
+
+    // Indices of nodes whose value is not used yet
+    Index_Stack stack = {0};
+    for (size_t i = 0; i < order->count; ++i) {
+        const Ast_Node *node = order->items[i];
+        Value_Type type;
+
+        switch (node->token.type) {
+            case TYPE_VALUE: type = node->token.val.type; break;
+            case TYPE_VARIABLE: type = vl->items[node->token.var].val.type; break;
+            default: {
+                uint32_t r = stack.items[--stack.count];
+                uint32_t l = stack.items[--stack.count];
+                type = types->items[l] & types->items[r];  // see Value_Type
+            }
+        }
+
+        da_append(types, type);
+        da_append(&stack, (uint32_t) i);
+    }
+
+    da_clean(&stack);
+    return types->count > 0 ? types->items[types->count - 1] : VAL_INT;
+}
+
+static uint32_t typed_emit(Typed *typed, Typed_Op op, uint32_t arg)
+{
+    da_append(typed, ((Inst) { .op = op, .arg = arg }));
+    return (uint32_t) typed->count - 1;
+}
+
+// i64 operand of f64 operation. Literal is converted right here,
+// everything else by an instruction
+static void typed_convert(Typed *typed, Typed_Operand operand, Typed_Op op)
+{
+    Inst inst = typed->items[operand.inst];
+    if (inst.op == TOP_PUSH) {
+        Value *val = &typed->consts.items[inst.arg];
+        *val = VALUE_FLOAT((double) val->i64);
+        return;
+    }
+    typed_emit(typed, op, 0);
+}
+
+void typed_compile(Typed *typed, Ast *ast)
+{
+    typed->count = 0;
+    typed->consts.count = 0;
+    typed->guards.count = 0;
+    typed->max_stack = 0;
+    bc_compile(&typed->prog, ast);
+
+    const Node_Stack *order = ast_order(ast);
+    typed->type = ast_infer(ast, &typed->types);
+    const Value_Type *types = typed->types.items;
+
+    Typed_Operands *operands = &typed->operands;
+    operands->count = 0;
+
+    for (size_t i = 0; i < order->count; ++i) {
+        const Ast_Node *node = order->items[i];
+        uint32_t inst;
+
+        if (node->token.type == TYPE_VALUE) {
+            da_append(&typed->consts, node->token.val);
+            inst = typed_emit(typed, TOP_PUSH, (uint32_t) typed->consts.count - 1);
+
+        } else if (node->token.type == TYPE_VARIABLE) {
+            guard_add(&typed->guards, (uint32_t) node->token.var, types[i]);
+            inst = typed_emit(typed, TOP_LOAD, (uint32_t) node->token.var);
+
+        } else {
+            Typed_Operand r = operands->items[--operands->count];
+            Typed_Operand l = operands->items[--operands->count];
+
+            // Right operand is on top, so it is converted first
+            if (types[i] == VAL_FLOAT) {
+                if (types[r.node] == VAL_INT) typed_convert(typed, r, TOP_I2F);
+                if (types[l.node] == VAL_INT) typed_convert(typed, l, TOP_I2F_NEXT);
+            }
+
+            Typed_Op base = types[i] == VAL_FLOAT ? TOP_ADD_F : TOP_ADD_I;
+            switch (node->token.op) {
+                case '+': inst = typed_emit(typed, base + 0, 0); break;
+                case '-': inst = typed_emit(typed, base + 1, 0); break;
+                case '*': inst = typed_emit(typed, base + 2, 0); break;
+                case '/': inst = typed_emit(typed, base + 3, 0); break;
+                default: {
+                    fprintf(stderr, "Error, unknown operator `%c`\n", node->token.op);
+                    EXIT;
+                }
+            }
+        }
+
+        da_append(operands, ((Typed_Operand) { .node = (uint32_t) i, .inst = inst }));
+        if (operands->count > typed->max_stack) typed->max_stack = operands->count;
+    }
+
+    typed_emit(typed, TOP_HALT, 0);
+}
+
+void typed_clean(Typed *typed)
+{
+    free(typed->items);
+    da_clean(&typed->consts);
+    da_clean(&typed->guards);
+    bc_clean(&typed->prog);
+    da_clean(&typed->types);
+    da_clean(&typed->operands);
+    *typed = (Typed) {0};
+}
+
+#define TYPED_BINARY_OP(sp, field, operator)                        \
+    do {                                                            \
+        (sp)[-2].field = (sp)[-2].field operator (sp)[-1].field;    \
+        (sp)--;                                                     \
+    } while (0)
+
+// Threaded dispatch as in `bc_eval`
+#define TYPED_NEXT() goto *labels[(++ip)->op]
+
+BC_DISPATCH_FN
+static Slot typed_run(const Typed *typed, const Var_List *vl, Slot *stack)
+{
+    static void *labels[TOP_COUNT] = {
+        [TOP_PUSH]     = &&op_push,
+        [TOP_LOAD]     = &&op_load,
+        [TOP_I2F]      = &&op_i2f,
+        [TOP_I2F_NEXT] = &&op_i2f_next,
+        [TOP_ADD_I]    = &&op_add_i,
+        [TOP_SUB_I]    = &&op_sub_i,
+        [TOP_MUL_I]    = &&op_mul_i,
+        [TOP_DIV_I]    = &&op_div_i,
+        [TOP_ADD_F]    = &&op_add_f,
+        [TOP_SUB_F]    = &&op_sub_f,
+        [TOP_MUL_F]    = &&op_mul_f,
+        [TOP_DIV_F]    = &&op_div_f,
+        [TOP_HALT]     = &&op_halt,
+    };
+
+    const Inst *ip = typed->items;
+    const Value *consts = typed->consts.items;
+    Slot *sp = stack;
+
+    goto *labels[ip->op];
+
+op_push:
+    (sp++)->i64 = consts[ip->arg].i64;
+    TYPED_NEXT();
+op_load:
+    (sp++)->i64 = vl->items[ip->arg].val.i64;
+    TYPED_NEXT();
+op_i2f:
+    sp[-1].f64 = (double) sp[-1].i64;
+    TYPED_NEXT();
+op_i2f_next:
+    sp[-2].f64 = (double) sp[-2].i64;
+    TYPED_NEXT();
+op_add_i:
+    TYPED_BINARY_OP(sp, i64, +);
+    TYPED_NEXT();
+op_sub_i:
+    TYPED_BINARY_OP(sp, i64, -);
+    TYPED_NEXT();
+op_mul_i:
+    TYPED_BINARY_OP(sp, i64, *);
+    TYPED_NEXT();
+op_div_i:
+    TYPED_BINARY_OP(sp, i64, /);
+    TYPED_NEXT();
+op_add_f:
+    TYPED_BINARY_OP(sp, f64, +);
+    TYPED_NEXT();
+op_sub_f:
+    TYPED_BINARY_OP(sp, f64, -);
+    TYPED_NEXT();
+op_mul_f:
+    TYPED_BINARY_OP(sp, f64, *);
+    TYPED_NEXT();
+op_div_f:
+    TYPED_BINARY_OP(sp, f64, /);
+    TYPED_NEXT();
+op_halt:
+    return stack[0];
+}
+
+// Slots are half of Value, so the same stack fits both paths
+Value typed_eval(const Typed *typed, const Var_List *vl, Value *stack)
+{
+    if (!guard_check(&typed->guards, vl)) return bc_eval(&typed->prog, vl, stack);
+
+    Value res = { .type = typed->type };
+    res.i64 = typed_run(typed, vl, (Slot *) stack).i64;
+    return res;
+}
+
+void print_typed(Typed *typed)
+{
+    static const char *names[TOP_COUNT] = {
+        [TOP_PUSH]     = "push",
+        [TOP_LOAD]     = "load",
+        [TOP_I2F]      = "i2f",
+        [TOP_I2F_NEXT] = "i2f.next",
+        [TOP_ADD_I]    = "add.i",
+        [TOP_SUB_I]    = "sub.i",
+        [TOP_MUL_I]    = "mul.i",
+        [TOP_DIV_I]    = "div.i",
+        [TOP_ADD_F]    = "add.f",
+        [TOP_SUB_F]    = "sub.f",
+        [TOP_MUL_F]    = "mul.f",
+        [TOP_DIV_F]    = "div.f",
+        [TOP_HALT]     = "halt",
+    };
+
+    printf("\n-------------------------- Typed ---------------------------\n\n");
+    for (size_t i = 0; i < typed->count; ++i) {
+        Inst inst = typed->items[i];
+        printf("%4zu: %s", i, names[inst.op]);
+        if (inst.op == TOP_PUSH) {
+            printf(" ");
+            print_token((Token) { .type = TYPE_VALUE, .val = typed->consts.items[inst.arg] });
+        } else if (inst.op == TOP_LOAD) {
+            printf(" var[%u]\n", inst.arg);
+        } else {
+            printf("\n");
+        }
+    }
+    printf("result: %s\n", typed->type == VAL_FLOAT ? "f64" : "i64");
+    printf("\n------------------------------------------------------------\n\n");
+}
@@ -1,22 +1,111 @@
 #include "../include/var.h"
 
-void var_clean(Var_List *vl) { da_clean(vl); }
-void var_push(Var_List *vl, Variable var) { da_append(vl, var); }
+void var_clean(Var_List *vl)
+{
+    da_clean(vl);
+    free(vl->index);
+    vl->index = NULL;
+    vl->index_capacity = 0;
+    arena_free(&vl->names);
+}
 
 Variable var_create(char *name, Value val)
 {
+    String_View sv = sv_from_cstr(name);
     return (Variable) {
-        .name = sv_from_cstr(name),
+        .name = sv,
+        .hash = sv_hash(sv),
         .val = val
     };
 }
 
-Variable var_search(Var_List *vl, String_View name)
+// Returns slot in `index` which holds variable with such name or empty slot
+static size_t var_probe(Var_List *vl, String_View name, uint64_t hash)
+{
+    size_t mask = vl->index_capacity - 1;
+    size_t slot = hash & mask;
+    size_t probes = 1;
+
+    while (vl->index[slot] != 0) {
+        Variable *var = &vl->items[vl->index[slot] - 1];
+        if (var->hash == hash && sv_cmp(var->name, name)) break;
+        slot = (slot + 1) & mask;
+        probes++;
+    }
+
+    STATS_ADD(STAT_VAR_LOOKUPS, 1);
+    STATS_ADD(STAT_VAR_PROBES, probes);
+    STATS_HIST(HIST_VAR_PROBE, probes);
+    (void) probes;
+    return slot;
+}
+
+static void var_index_grow(Var_List *vl)
 {
+    free(vl->index);
+    vl->index_capacity = vl->index_capacity > 0 ? vl->index_capacity * 2 : INIT_CAPACITY;
+    vl->index = calloc(vl->index_capacity, sizeof(*vl->index));
+    assert(vl->index != NULL);
+
+    // Names are unique, so only an empty slot is looked for
+    size_t mask = vl->index_capacity - 1;
     for (size_t i = 0; i < vl->count; ++i) {
-        if (sv_cmp(vl->items[i].name, name)) {
-            return vl->items[i];
-        }
+        size_t slot = vl->items[i].hash & mask;
+        while (vl->index[slot] != 0) slot = (slot + 1) & mask;
+        vl->index[slot] = (uint32_t) (i + 1);
+    }
+}
+
+// If variable with the same name already exists its value is updated.
+// Hash is taken from the name here, `var.hash` of the caller is not trusted
+void var_push(Var_List *vl, Variable var)
+{
+    var.hash = sv_hash(var.name);
+
+    // Keep load factor under 1/2 so probe sequences stay short
+    if ((vl->count + 1) * 2 > vl->index_capacity) {
+        var_index_grow(vl);
+    }
+
+    size_t slot = var_probe(vl, var.name, var.hash);
+    if (vl->index[slot] != 0) {
+        Variable *old = &vl->items[vl->index[slot] - 1];
+        old->val = var.val;
+        old->stamp = ++vl->tick;
+        vl->log[vl->tick % VAR_LOG] = vl->index[slot] - 1;
+        return;
     }
-    return VAR_NONE;
-}
\ No newline at end of file
+    var.stamp = ++vl->tick;
+    vl->log[vl->tick % VAR_LOG] = (uint32_t) vl->count;
+
+    char *name = arena_alloc(&vl->names, var.name.count);
+    memcpy(name, var.name.data, var.name.count);
+    var.name.data = name;
+
+    da_append(vl, var);
+    vl->index[slot] = (uint32_t) vl->count;
+}
+
+// Index of variable in `items` is stable for whole life of the list
+size_t var_find(Var_List *vl, String_View name)
+{
+    return var_find_hash(vl, name, sv_hash(name));
+}
+
+// `hash` must be sv_hash(name), for callers which keep it, e.g. images
+size_t var_find_hash(Var_List *vl, String_View name, uint64_t hash)
+{
+    if (vl->count == 0) return VAR_NOT_FOUND;
+
+    size_t slot = var_probe(vl, name, hash);
+    if (vl->index[slot] == 0) return VAR_NOT_FOUND;
+
+    return vl->index[slot] - 1;
+}
+
+Variable var_search(Var_List *vl, String_View name)
+{
+    size_t var = var_find(vl, name);
+    if (var == VAR_NOT_FOUND) return VAR_NONE;
+    return vl->items[var];
+}
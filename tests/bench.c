@@ -0,0 +1,1196 @@
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/batch.h"
+#include "../include/pipeline.h"
+#include "../include/number.h"
+#include "../include/cache.h"
+#include "../include/dag.h"
+#include "../include/jit.h"
+#include "../include/image.h"
+#include "../include/incr.h"
+#include "../include/io.h"
+#include "../include/checked.h"
+#include "../include/typed.h"
+
+// Tables are printed for humans. With --csv every measurement is
+// one "suite,case,size,metric,value" line instead, to be tracked over time
+static int bench_csv = 0;
+
+#define TABLE(...) do { if (!bench_csv) printf(__VA_ARGS__); } while (0)
+
+static void record(const char *suite, const char *name, size_t size, const char *metric, double value)
+{
+    if (bench_csv) printf("%s,%s,%zu,%s,%.3f\n", suite, name, size, metric, value);
+}
+
+// Bench is linked with --wrap for these, so every allocation made
+// by the library goes through here and is counted
+static size_t bench_allocs = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+    __atomic_add_fetch(&bench_allocs, 1, __ATOMIC_RELAXED);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    __atomic_add_fetch(&bench_allocs, 1, __ATOMIC_RELAXED);
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    __atomic_add_fetch(&bench_allocs, 1, __ATOMIC_RELAXED);
+    return __real_realloc(ptr, size);
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+// Variable names can contain only letters, so number is written in base 26
+static void var_name(char *buf, size_t n)
+{
+    size_t i = 0;
+    do {
+        buf[i++] = 'a' + n % 26;
+        n /= 26;
+    } while (n > 0);
+    buf[i] = '\0';
+}
+
+#define LOOKUPS 1000000
+
+static void bench_var_search(void)
+{
+    TABLE("\n------------------------ var_search ------------------------\n\n");
+    TABLE("%10s %14s\n", "variables", "ns/lookup");
+
+    char name[16];
+    for (size_t size = 10; size <= 1000000; size *= 10) {
+        Var_List vl = {0};
+        for (size_t i = 0; i < size; ++i) {
+            var_name(name, i);
+            var_push(&vl, var_create(name, VALUE_INT((i64_t) i)));
+        }
+
+        // Names are generated before timing, only lookups are measured
+        String_View *names = malloc(sizeof(String_View) * LOOKUPS);
+        assert(names != NULL);
+        uint64_t seed = 88172645463325252ULL;
+        for (size_t i = 0; i < LOOKUPS; ++i) {
+            seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+            names[i] = vl.items[seed % size].name;
+        }
+
+        i64_t sum = 0;
+        double start = now_ns();
+        for (size_t i = 0; i < LOOKUPS; ++i) {
+            sum += var_search(&vl, names[i]).val.i64;
+        }
+        double elapsed = now_ns() - start;
+
+        TABLE("%10zu %14.2f\n", size, elapsed / LOOKUPS);
+        record("var_search", "lookup", size, "ns_op", elapsed / LOOKUPS);
+        if (sum < 0) fprintf(stderr, "unreachable\n");
+
+        free(names);
+        var_clean(&vl);
+    }
+    TABLE("\n------------------------------------------------------------\n\n");
+}
+
+#define ROWS (1 << 20)
+
+static void bench_batch(void)
+{
+    TABLE("\n----------------------- bc_eval_batch ----------------------\n\n");
+
+    Var_List vl = {0};
+    var_push(&vl, var_create("base", VALUE_INT(0)));
+    var_push(&vl, var_create("idx", VALUE_INT(0)));
+    var_push(&vl, var_create("x", VALUE_FLOAT(0)));
+
+    char *exprs[] = {
+        "base + idx * 4 - 8",
+        "base + idx - (base - 16) + 3",
+        "x * 2.0 + x / 3.0 - 1.5",
+    };
+
+    i64_t *bases = malloc(sizeof(i64_t) * ROWS);
+    i64_t *idxs = malloc(sizeof(i64_t) * ROWS);
+    double *xs = malloc(sizeof(double) * ROWS);
+    i64_t *out = malloc(sizeof(i64_t) * ROWS);
+    assert(bases && idxs && xs && out);
+    memset(out, 0, sizeof(i64_t) * ROWS);
+    for (size_t i = 0; i < ROWS; ++i) {
+        bases[i] = (i64_t) i * 4096;
+        idxs[i] = (i64_t) (i % 64);
+        xs[i] = (double) i * 0.5;
+    }
+
+    Column cols[3] = {
+        { .type = VAL_INT, .data = bases },
+        { .type = VAL_INT, .data = idxs },
+        { .type = VAL_FLOAT, .data = xs },
+    };
+
+    Batch_Scratch scratch = {0};
+    TABLE("%-32s %12s %12s\n", "expression", "row ns/row", "batch ns/row");
+    for (size_t e = 0; e < sizeof(exprs) / sizeof(exprs[0]); ++e) {
+        Ast ast = {0};
+        Program prog = {0};
+        Lexer lex = lexer(sv_from_cstr(exprs[e]), &vl);
+        parser(&ast, &lex);
+        bc_compile(&prog, &ast);
+
+        // One bc_eval per row with variables updated in place
+        Value stack[prog.max_stack];
+        i64_t sum = 0;
+        double start = now_ns();
+        for (size_t i = 0; i < ROWS; ++i) {
+            vl.items[0].val.i64 = bases[i];
+            vl.items[1].val.i64 = idxs[i];
+            vl.items[2].val.f64 = xs[i];
+            sum += bc_eval(&prog, &vl, stack).i64;
+        }
+        double row = (now_ns() - start) / ROWS;
+
+        start = now_ns();
+        bc_eval_batch(&prog, cols, ROWS, out, &scratch);
+        double batch = (now_ns() - start) / ROWS;
+
+        TABLE("%-32s %12.2f %12.2f\n", exprs[e], row, batch);
+        record("batch", exprs[e], ROWS, "row_ns", row);
+        record("batch", exprs[e], ROWS, "batch_ns", batch);
+        if (sum == 42 && out[0] == 42) fprintf(stderr, "unreachable\n");
+
+        bc_clean(&prog);
+        ast_clean(&ast);
+        lex_clean(&lex);
+    }
+
+    batch_clean(&scratch);
+    free(bases);
+    free(idxs);
+    free(xs);
+    free(out);
+    var_clean(&vl);
+    TABLE("\n------------------------------------------------------------\n\n");
+}
+
+#define EXPRS 200000
+
+static void bench_pipeline(void)
+{
+    TABLE("\n----------------------- pipeline_eval ----------------------\n\n");
+
+    Var_List vl = {0};
+    var_push(&vl, var_create("base", VALUE_INT(4096)));
+    var_push(&vl, var_create("idx", VALUE_INT(3)));
+
+    // Every expression gets its own buffer, so they are really independent
+    String_View *exprs = malloc(sizeof(String_View) * EXPRS);
+    Value *results = malloc(sizeof(Value) * EXPRS);
+    Expr_Status *status = malloc(sizeof(Expr_Status) * EXPRS);
+    assert(exprs != NULL && results != NULL && status != NULL);
+    for (size_t i = 0; i < EXPRS; ++i) {
+        char *buf = malloc(64);
+        assert(buf != NULL);
+        snprintf(buf, 64, "base + (idx + %zu) * 4 - %zu * (2 + idx)", i % 97, i % 13);
+        exprs[i] = sv_from_cstr(buf);
+    }
+
+    TABLE("%8s %14s %14s\n", "threads", "ns/expr", "exprs/s");
+    for (size_t threads = 1; threads <= 8; threads *= 2) {
+        double start = now_ns();
+        pipeline_eval(exprs, EXPRS, &vl, results, status, threads);
+        double elapsed = now_ns() - start;
+        TABLE("%8zu %14.2f %14.0f\n", threads, elapsed / EXPRS, EXPRS / elapsed * 1e9);
+        record("pipeline", "threads", threads, "ns_expr", elapsed / EXPRS);
+    }
+
+    for (size_t i = 0; i < EXPRS; ++i) free(exprs[i].data);
+    free(exprs);
+    free(results);
+    free(status);
+    var_clean(&vl);
+    TABLE("\n------------------------------------------------------------\n\n");
+}
+
+#define LITERALS 1000000
+
+static void bench_number(void)
+{
+    TABLE("\n------------------------ number_parse ----------------------\n\n");
+
+    // Literals are packed one after another, views point into the pool
+    char *pool = malloc(LITERALS * 32);
+    String_View *ints = malloc(sizeof(String_View) * LITERALS);
+    String_View *floats = malloc(sizeof(String_View) * LITERALS);
+    assert(pool != NULL && ints != NULL && floats != NULL);
+
+    char *p = pool;
+    uint64_t seed = 88172645463325252ULL;
+    for (size_t i = 0; i < LITERALS; ++i) {
+        seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+        int n = sprintf(p, "%llu", (unsigned long long) (seed >> (seed % 50 + 1)));
+        ints[i] = (String_View) { .data = p, .count = n };
+        p += n + 1;
+    }
+    char *fpool = p;
+    for (size_t i = 0; i < LITERALS; ++i) {
+        seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+        int n = sprintf(fpool, "%llu.%llu", (unsigned long long) (seed % 100000),
+                        (unsigned long long) (seed >> 40) % 1000);
+        floats[i] = (String_View) { .data = fpool, .count = n };
+        fpool += n + 1;
+    }
+
+    i64_t isum = 0;
+    double fsum = 0, libc_fsum = 0;
+    double start = now_ns();
+    for (size_t i = 0; i < LITERALS; ++i) {
+        i64_t v;
+        number_parse_i64(ints[i], &v);
+        isum += v;
+    }
+    double parse_i64 = (now_ns() - start) / LITERALS;
+
+    // Literals are NUL-terminated in the pool, so strtoll reads them in place
+    start = now_ns();
+    for (size_t i = 0; i < LITERALS; ++i) isum -= strtoll(ints[i].data, NULL, 10);
+    double libc_i64 = (now_ns() - start) / LITERALS;
+
+    start = now_ns();
+    for (size_t i = 0; i < LITERALS; ++i) {
+        double v;
+        number_parse_f64(floats[i], &v);
+        fsum += v;
+    }
+    double parse_f64 = (now_ns() - start) / LITERALS;
+
+    start = now_ns();
+    for (size_t i = 0; i < LITERALS; ++i) libc_fsum += strtod(floats[i].data, NULL);
+    double libc_f64 = (now_ns() - start) / LITERALS;
+
+    TABLE("%6s %18s %18s\n", "type", "number_parse ns", "libc ns");
+    TABLE("%6s %18.2f %18.2f\n", "i64", parse_i64, libc_i64);
+    TABLE("%6s %18.2f %18.2f\n", "f64", parse_f64, libc_f64);
+    record("number", "i64", LITERALS, "ns_op", parse_i64);
+    record("number", "i64", LITERALS, "libc_ns_op", libc_i64);
+    record("number", "f64", LITERALS, "ns_op", parse_f64);
+    record("number", "f64", LITERALS, "libc_ns_op", libc_f64);
+    if (isum != 0 || fsum != libc_fsum) fprintf(stderr, "Error: results differ\n");
+
+    free(pool);
+    free(ints);
+    free(floats);
+    TABLE("\n------------------------------------------------------------\n\n");
+}
+
+#define CORPUS_SIZE (8 << 20)
+
+// One long expression of ints, floats, variables and brackets
+static char *lex_corpus(size_t size, int spaces)
+{
+    static const char *names[] = { "base", "index", "offset", "counter" };
+    static const char ops[] = "+-*/";
+
+    char *corpus = malloc(size + 128);
+    assert(corpus != NULL);
+
+    size_t n = 0;
+    uint64_t seed = 88172645463325252ULL;
+    while (n < size) {
+        seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+        switch (seed % 4) {
+            case 0: n += sprintf(corpus + n, "%llu", (unsigned long long) (seed >> 20)); break;
+            case 1: n += sprintf(corpus + n, "%llu.%llu", (unsigned long long) (seed >> 44),
+                                 (unsigned long long) (seed >> 54)); break;
+            case 2: n += sprintf(corpus + n, "%s", names[(seed >> 8) % 4]); break;
+            case 3: n += sprintf(corpus + n, "(%llu)", (unsigned long long) (seed >> 50)); break;
+        }
+        n += sprintf(corpus + n, "%*s%c%*s", spaces, "", ops[(seed >> 4) % 4], spaces, "");
+    }
+    n += sprintf(corpus + n, "1");
+
+    return corpus;
+}
+
+static void bench_lexer(void)
+{
+    TABLE("\n--------------------------- lexer --------------------------\n\n");
+
+    Var_List vl = {0};
+    var_push(&vl, var_create("base", VALUE_INT(0)));
+    var_push(&vl, var_create("index", VALUE_INT(0)));
+    var_push(&vl, var_create("offset", VALUE_INT(0)));
+    var_push(&vl, var_create("counter", VALUE_INT(0)));
+
+    TABLE("%8s %14s %14s %14s\n", "spaces", "tokens", "lexer MB/s", "stream MB/s");
+    for (int spaces = 0; spaces <= 16; spaces += 4) {
+        char *corpus = lex_corpus(CORPUS_SIZE, spaces);
+        String_View src = sv_from_cstr(corpus);
+
+        double start = now_ns();
+        Lexer lex = lexer(src, &vl);
+        double array = now_ns() - start;
+
+        start = now_ns();
+        Lexer stream = lexer_stream(src, &vl);
+        size_t tokens = 0;
+        while (token_next(&stream).type != TYPE_NONE) tokens++;
+        double streamed = now_ns() - start;
+
+        if (tokens != lex.count) fprintf(stderr, "Error: token count differs\n");
+        TABLE("%8d %14zu %14.1f %14.1f\n", spaces, tokens,
+               src.count / array * 1e3, src.count / streamed * 1e3);
+        record("lexer", "spaces", spaces, "mb_s", src.count / array * 1e3);
+        record("lexer", "spaces", spaces, "stream_mb_s", src.count / streamed * 1e3);
+
+        lex_clean(&lex);
+        free(corpus);
+    }
+
+    var_clean(&vl);
+    TABLE("\n------------------------------------------------------------\n\n");
+}
+
+typedef enum {
+    SHAPE_FLAT = 0,     // 1+2-3+...
+    SHAPE_NESTED,       // 1+(2+(3+...)), right deep
+    SHAPE_MIXED,        // ints and floats
+    SHAPE_VARS,         // mostly variables
+    SHAPE_LITERALS,     // 18 digit ints and floats which go to strtod
+    SHAPE_COUNT
+} Shape;
+
+static const char *shape_names[SHAPE_COUNT] = {
+    [SHAPE_FLAT]     = "flat",
+    [SHAPE_NESTED]   = "nested",
+    [SHAPE_MIXED]    = "mixed",
+    [SHAPE_VARS]     = "vars",
+    [SHAPE_LITERALS] = "literals",
+};
+
+static const char *shape_vars[] = { "base", "index", "offset", "counter" };
+
+// Expression of `terms` operands. Mixed and literal shapes start with a float,
+// so the whole chain is computed in f64 and can not overflow
+static char *shape_corpus(Shape shape, size_t terms)
+{
+    char *corpus = malloc(terms * 48 + 16);
+    assert(corpus != NULL);
+
+    size_t n = 0;
+    uint64_t seed = 88172645463325252ULL;
+    for (size_t i = 0; i < terms; ++i) {
+        seed ^= seed << 13; seed ^= seed >> 7; seed ^= seed << 17;
+        if (i > 0) corpus[n++] = "+-"[seed % 2];
+
+        switch (shape) {
+            case SHAPE_FLAT:
+            case SHAPE_NESTED:
+                if (shape == SHAPE_NESTED && i > 0) corpus[n++] = '(';
+                corpus[n++] = '1' + seed % 9;
+                break;
+            case SHAPE_MIXED:
+                if (i % 2 == 0) n += sprintf(corpus + n, "%llu.%02llu", (unsigned long long) (seed >> 54),
+                                             (unsigned long long) (seed >> 8) % 100);
+                else n += sprintf(corpus + n, "%llu", (unsigned long long) (seed >> 54));
+                break;
+            case SHAPE_VARS:
+                if (i % 4 == 3) n += sprintf(corpus + n, "%llu", (unsigned long long) (seed >> 56));
+                else n += sprintf(corpus + n, "%s", shape_vars[(seed >> 8) % 4]);
+                break;
+            case SHAPE_LITERALS:
+                if (i % 2 == 0) n += sprintf(corpus + n, "%llu.%llu", (unsigned long long) (seed >> 4),
+                                             (unsigned long long) (seed >> 12));
+                else n += sprintf(corpus + n, "%018llu", (unsigned long long) (seed % 1000000000000000000ULL));
+                break;
+            default: assert(0 && "unreachable");
+        }
+    }
+
+    if (shape == SHAPE_NESTED) {
+        memset(corpus + n, ')', terms - 1);
+        n += terms - 1;
+    }
+    corpus[n] = '\0';
+
+    return corpus;
+}
+
+// Every size runs about this many terms through each phase
+#define PHASE_WORK 2000000
+
+static void phase_report(Shape shape, size_t terms, const char *phase, double ns,
+                         size_t tokens, size_t nodes, double allocs)
+{
+    TABLE("%10s %10zu %8s %16.0f %12.2f %12.2f %12.2f\n", shape_names[shape], terms, phase,
+          ns, tokens / ns * 1e3, nodes / ns * 1e3, allocs);
+
+    char name[32];
+    snprintf(name, sizeof(name), "%s/%s", shape_names[shape], phase);
+    record("phases", name, terms, "ns_op", ns);
+    record("phases", name, terms, "tokens_s", tokens / ns * 1e9);
+    record("phases", name, terms, "nodes_s", nodes / ns * 1e9);
+    record("phases", name, terms, "allocs", allocs);
+}
+
+// One op is one call of `lexer`, `parser` or `ast_eval` on the whole corpus
+static void bench_phases(void)
+{
+    TABLE("\n-------------------------- phases --------------------------\n\n");
+
+    Var_List vl = {0};
+    for (size_t i = 0; i < sizeof(shape_vars) / sizeof(shape_vars[0]); ++i) {
+        var_push(&vl, var_create((char *) shape_vars[i], VALUE_INT((i64_t) i + 1)));
+    }
+
+    TABLE("%10s %10s %8s %16s %12s %12s %12s\n",
+          "shape", "terms", "phase", "ns/op", "Mtokens/s", "Mnodes/s", "allocs/op");
+    for (Shape shape = 0; shape < SHAPE_COUNT; ++shape) {
+        for (size_t terms = 1000; terms <= 1000000; terms *= 10) {
+            char *corpus = shape_corpus(shape, terms);
+            String_View src = sv_from_cstr(corpus);
+            size_t reps = PHASE_WORK / terms;
+
+            // Warm up, so parser stacks and arena are already grown
+            Ast ast = {0};
+            Lexer lex = lexer(src, &vl);
+            parser(&ast, &lex);
+            ast_eval(&ast);
+            size_t tokens = lex.count;
+            size_t nodes = ast.count;
+            ast_reset(&ast);
+
+            size_t allocs = bench_allocs;
+            double start = now_ns();
+            for (size_t r = 0; r < reps; ++r) {
+                Lexer again = lexer(src, &vl);
+                lex_clean(&again);
+            }
+            phase_report(shape, terms, "lex", (now_ns() - start) / reps, tokens, nodes,
+                         (double) (bench_allocs - allocs) / reps);
+
+            allocs = bench_allocs;
+            start = now_ns();
+            for (size_t r = 0; r < reps; ++r) {
+                lex.tp = 0;
+                ast_reset(&ast);
+                parser(&ast, &lex);
+            }
+            phase_report(shape, terms, "parse", (now_ns() - start) / reps, tokens, nodes,
+                         (double) (bench_allocs - allocs) / reps);
+
+            allocs = bench_allocs;
+            start = now_ns();
+            for (size_t r = 0; r < reps; ++r) ast_eval(&ast);
+            phase_report(shape, terms, "eval", (now_ns() - start) / reps, tokens, nodes,
+                         (double) (bench_allocs - allocs) / reps);
+
+            ast_clean(&ast);
+            lex_clean(&lex);
+            free(corpus);
+        }
+    }
+
+    var_clean(&vl);
+    TABLE("\n------------------------------------------------------------\n\n");
+}
+
+#define CACHE_LOOKUPS 1000000
+
+// Stream of `distinct` operand expressions, every one repeated many times
+static void bench_cache(void)
+{
+    TABLE("\n--------------------------- cache --------------------------\n\n");
+
+    Var_List vl = {0};
+    var_push(&vl, var_create("base", VALUE_INT(4096)));
+    var_push(&vl, var_create("idx", VALUE_INT(3)));
+
+    TABLE("%10s %10s %14s %14s %14s %10s\n",
+           "distinct", "capacity", "uncached ns", "cached ns", "changing ns", "hit rate");
+    for (size_t distinct = 16; distinct <= 4096; distinct *= 16) {
+        char (*srcs)[64] = malloc(64 * distinct);
+        assert(srcs != NULL);
+        for (size_t i = 0; i < distinct; ++i) {
+            snprintf(srcs[i], 64, "base + 4 * idx + %zu", i);
+        }
+
+        // Full lexer + parser + eval on every occurrence
+        Ast ast = {0};
+        double start = now_ns();
+        for (size_t i = 0; i < CACHE_LOOKUPS; ++i) {
+            Lexer lex = lexer_stream(sv_from_cstr(srcs[i % distinct]), &vl);
+            parser(&ast, &lex);
+            ast_eval(&ast);
+            ast_reset(&ast);
+        }
+        double uncached = (now_ns() - start) / CACHE_LOOKUPS;
+        ast_clean(&ast);
+
+        // Constant variables: values are reused. Changing `idx`: only programs are
+        Cache cache = {0};
+        start = now_ns();
+        for (size_t i = 0; i < CACHE_LOOKUPS; ++i) {
+            cache_eval(&cache, sv_from_cstr(srcs[i % distinct]), &vl);
+        }
+        double cached = (now_ns() - start) / CACHE_LOOKUPS;
+
+        start = now_ns();
+        for (size_t i = 0; i < CACHE_LOOKUPS; ++i) {
+            var_push(&vl, var_create("idx", VALUE_INT((i64_t) i)));
+            cache_eval(&cache, sv_from_cstr(srcs[i % distinct]), &vl);
+        }
+        double changing = (now_ns() - start) / CACHE_LOOKUPS;
+
+        TABLE("%10zu %10zu %14.2f %14.2f %14.2f %9.1f%%\n", distinct, cache.capacity, uncached, cached, changing,
+               100.0 * cache.hits / (cache.hits + cache.misses));
+        record("cache", "distinct", distinct, "uncached_ns", uncached);
+        record("cache", "distinct", distinct, "cached_ns", cached);
+        record("cache", "distinct", distinct, "changing_ns", changing);
+        record("cache", "distinct", distinct, "hit_rate", (double) cache.hits / (cache.hits + cache.misses));
+
+        cache_clean(&cache);
+        free(srcs);
+    }
+
+    var_clean(&vl);
+    TABLE("\n------------------------------------------------------------\n\n");
+}
+
+#define DAG_EXPRS 10000
+#define DAG_ROUNDS 100
+
+// Generated operand expressions which repeat the same subexpressions,
+// every round changes `idx` and evaluates all of them again
+static void bench_dag(void)
+{
+    TABLE("\n---------------------------- dag ---------------------------\n\n");
+
+    Var_List vl = {0};
+    var_push(&vl, var_create("base", VALUE_INT(4096)));
+    var_push(&vl, var_create("idx", VALUE_INT(3)));
+
+    TABLE("%10s %12s %12s %14s %14s\n", "distinct", "tree nodes", "dag nodes", "bytecode ns", "dag ns");
+    for (size_t distinct = 4; distinct <= 4096; distinct *= 32) {
+        Ast ast = {0};
+        Dag dag = {0};
+        Program *progs = calloc(DAG_EXPRS, sizeof(Program));
+        uint32_t *roots = malloc(sizeof(uint32_t) * DAG_EXPRS);
+        assert(progs != NULL && roots != NULL);
+
+        size_t tree_nodes = 0;
+        size_t max_stack = 0;
+        char buf[128];
+        for (size_t i = 0; i < DAG_EXPRS; ++i) {
+            size_t k = i % distinct;
+            snprintf(buf, sizeof(buf), "(base + 4 * idx) * %zu + (base - %zu) * (idx + %zu) - (2 + 3) * %zu",
+                     i % 7, k, k % 5, i % 3);
+            Lexer lex = lexer_stream(sv_from_cstr(buf), &vl);
+            parser(&ast, &lex);
+            tree_nodes += ast.count;
+            bc_compile(&progs[i], &ast);
+            if (progs[i].max_stack > max_stack) max_stack = progs[i].max_stack;
+            roots[i] = dag_add(&dag, &ast);
+            ast_reset(&ast);
+        }
+
+        Value stack[max_stack];
+        i64_t sum = 0;
+        double start = now_ns();
+        for (size_t r = 0; r < DAG_ROUNDS; ++r) {
+            var_push(&vl, var_create("idx", VALUE_INT((i64_t) r)));
+            for (size_t i = 0; i < DAG_EXPRS; ++i) sum += bc_eval(&progs[i], &vl, stack).i64;
+        }
+        double bytecode = (now_ns() - start) / (DAG_ROUNDS * DAG_EXPRS);
+
+        start = now_ns();
+        for (size_t r = 0; r < DAG_ROUNDS; ++r) {
+            var_push(&vl, var_create("idx", VALUE_INT((i64_t) r)));
+            for (size_t i = 0; i < DAG_EXPRS; ++i) sum -= dag_eval(&dag, roots[i]).i64;
+        }
+        double shared = (now_ns() - start) / (DAG_ROUNDS * DAG_EXPRS);
+
+        TABLE("%10zu %12zu %12zu %14.2f %14.2f\n", distinct, tree_nodes, dag.count, bytecode, shared);
+        record("dag", "distinct", distinct, "tree_nodes", tree_nodes);
+        record("dag", "distinct", distinct, "dag_nodes", dag.count);
+        record("dag", "distinct", distinct, "bytecode_ns", bytecode);
+        record("dag", "distinct", distinct, "dag_ns", shared);
+        if (sum != 0) fprintf(stderr, "Error: results differ\n");
+
+        for (size_t i = 0; i < DAG_EXPRS; ++i) bc_clean(&progs[i]);
+        free(progs);
+        free(roots);
+        dag_clean(&dag);
+        ast_clean(&ast);
+    }
+
+    var_clean(&vl);
+    TABLE("\n------------------------------------------------------------\n\n");
+}
+
+#define JIT_EVALS 2000000
+
+// One expression evaluated many times, variables change before every call
+static void bench_jit(void)
+{
+    TABLE("\n---------------------------- jit ---------------------------\n\n");
+
+    Var_List vl = {0};
+    var_push(&vl, var_create("base", VALUE_INT(0)));
+    var_push(&vl, var_create("idx", VALUE_INT(0)));
+    var_push(&vl, var_create("x", VALUE_FLOAT(0)));
+
+    char *exprs[] = {
+        "base + idx * 4 - 8",
+        "base + idx - (base - 16) + 3",
+        "(base + idx * 8) / (idx + 1) - base * (idx - 3)",
+        "x * 2.0 + x / 3.0 - 1.5",
+        "((x + 1.5) * (x - 2.5) + 4.0) / (x * x + 1.0)",
+    };
+
+    TABLE("%-48s %12s %12s %12s %8s\n", "expression", "tree ns", "bytecode ns", "jit ns", "native");
+    for (size_t e = 0; e < sizeof(exprs) / sizeof(exprs[0]); ++e) {
+        Ast ast = {0};
+        Program prog = {0};
+        Jit jit = {0};
+        Lexer lex = lexer(sv_from_cstr(exprs[e]), &vl);
+        parser(&ast, &lex);
+        bc_compile(&prog, &ast);
+        int native = jit_compile(&jit, &ast);
+
+        Value stack[prog.max_stack];
+        i64_t sum = 0;
+        double times[3];
+        for (int mode = 0; mode < 3; ++mode) {
+            double start = now_ns();
+            for (size_t i = 0; i < JIT_EVALS; ++i) {
+                vl.items[0].val.i64 = (i64_t) i * 4096;
+                vl.items[1].val.i64 = (i64_t) (i % 64);
+                vl.items[2].val.f64 = (double) i * 0.5;
+
+                Value v;
+                switch (mode) {
+                    case 0: v = ast_eval(&ast); break;
+                    case 1: v = bc_eval(&prog, &vl, stack); break;
+                    default: v = jit_eval(&jit, &vl, stack); break;
+                }
+                sum += mode == 0 ? v.i64 : -v.i64 / 2;
+            }
+            times[mode] = (now_ns() - start) / JIT_EVALS;
+        }
+
+        TABLE("%-48s %12.2f %12.2f %12.2f %8s\n", exprs[e], times[0], times[1], times[2], native ? "yes" : "no");
+        record("jit", exprs[e], JIT_EVALS, "tree_ns", times[0]);
+        record("jit", exprs[e], JIT_EVALS, "bytecode_ns", times[1]);
+        record("jit", exprs[e], JIT_EVALS, "jit_ns", times[2]);
+        if (sum == 42) fprintf(stderr, "unreachable\n");
+
+        jit_clean(&jit);
+        bc_clean(&prog);
+        ast_clean(&ast);
+        lex_clean(&lex);
+    }
+
+    var_clean(&vl);
+    TABLE("\n------------------------------------------------------------\n\n");
+}
+
+#define CHECKED_EVALS 200000
+#define CHECKED_REPEATS 25
+
+// `bc_eval` against `bc_eval_checked` with each policy on inputs which
+// do not overflow, so only the cost of the checks is measured. Modes take
+// turns and best run of each is taken, as the difference is close to the noise
+static void bench_checked(void)
+{
+    TABLE("\n-------------------------- checked -------------------------\n\n");
+
+    Var_List vl = {0};
+    var_push(&vl, var_create("base", VALUE_INT(0)));
+    var_push(&vl, var_create("idx", VALUE_INT(0)));
+    var_push(&vl, var_create("x", VALUE_FLOAT(0)));
+
+    char *exprs[] = {
+        "base + idx * 4 - 8",
+        "base + idx - (base - 16) + 3",
+        "(base + idx * 8) / (idx + 1) - base * (idx - 3)",
+        "98721354+2355467*1654567+23445467*(2345467-2384567)+38676*8534567-3453456+(3454565*54675345)*(3400-645)",
+        "x * 2.0 + x / 3.0 - 1.5",
+    };
+
+    TABLE("%-48s %10s", "expression", "plain ns");
+    for (Arith_Policy p = 0; p < ARITH_POLICY_COUNT; ++p) TABLE(" %10s", arith_policy_name(p));
+    TABLE(" %10s\n", "trap over");
+
+    for (size_t e = 0; e < sizeof(exprs) / sizeof(exprs[0]); ++e) {
+        Ast ast = {0};
+        Program prog = {0};
+        Lexer lex = lexer(sv_from_cstr(exprs[e]), &vl);
+        parser(&ast, &lex);
+        bc_compile(&prog, &ast);
+
+        Value stack[prog.max_stack];
+        i64_t sum = 0;
+        size_t failed = 0;
+        // Mode 0 is `bc_eval`, mode 1 + p is policy p
+        double times[1 + ARITH_POLICY_COUNT];
+        for (int mode = 0; mode < 1 + ARITH_POLICY_COUNT; ++mode) times[mode] = 1e18;
+        for (int r = 0; r < CHECKED_REPEATS; ++r) {
+            for (int mode = 0; mode < 1 + ARITH_POLICY_COUNT; ++mode) {
+                double start = now_ns();
+                for (size_t i = 0; i < CHECKED_EVALS; ++i) {
+                    vl.items[0].val.i64 = (i64_t) i * 4096;
+                    vl.items[1].val.i64 = (i64_t) (i % 64);
+                    vl.items[2].val.f64 = (double) i * 0.5;
+
+                    Arith_Status status = ARITH_OK;
+                    Value v = mode == 0 ? bc_eval(&prog, &vl, stack)
+                                        : bc_eval_checked(&prog, &vl, stack, mode - 1, &status);
+                    sum += v.i64;
+                    failed += status != ARITH_OK;
+                }
+                double t = (now_ns() - start) / CHECKED_EVALS;
+                if (t < times[mode]) times[mode] = t;
+            }
+        }
+
+        double over = (times[1 + ARITH_TRAP] / times[0] - 1) * 100;
+        TABLE("%-48.48s %10.2f", exprs[e], times[0]);
+        for (Arith_Policy p = 0; p < ARITH_POLICY_COUNT; ++p) TABLE(" %10.2f", times[1 + p]);
+        TABLE(" %9.1f%%\n", over);
+        record("checked", exprs[e], CHECKED_EVALS, "plain_ns", times[0]);
+        for (Arith_Policy p = 0; p < ARITH_POLICY_COUNT; ++p) {
+            char metric[32];
+            snprintf(metric, sizeof(metric), "%s_ns", arith_policy_name(p));
+            record("checked", exprs[e], CHECKED_EVALS, metric, times[1 + p]);
+        }
+        if (failed > 0) fprintf(stderr, "Error: %zu checked evaluations failed\n", failed);
+        if (sum == 42) fprintf(stderr, "unreachable\n");
+
+        bc_clean(&prog);
+        ast_clean(&ast);
+        lex_clean(&lex);
+    }
+
+    var_clean(&vl);
+    TABLE("\n------------------------------------------------------------\n\n");
+}
+
+#define TYPED_EVALS 200000
+#define TYPED_REPEATS 25
+
+// `bc_eval` against `typed_eval` on int, float and mixed expressions.
+// Types of variables do not change, so guards always pass
+static void bench_typed(void)
+{
+    TABLE("\n--------------------------- typed --------------------------\n\n");
+
+    Var_List vl = {0};
+    var_push(&vl, var_create("base", VALUE_INT(0)));
+    var_push(&vl, var_create("idx", VALUE_INT(0)));
+    var_push(&vl, var_create("x", VALUE_FLOAT(0)));
+
+    char *exprs[] = {
+        "base + idx * 4 - 8",
+        "(base + idx * 8) / (idx + 1) - base * (idx - 3)",
+        "x * 2.0 + x / 3.0 - 1.5",
+        "base * 2.5 + idx",
+        "(base + idx * 8) / (x + 1) - base * (idx - 3)",
+    };
+
+    TABLE("%-48s %10s %10s %10s\n", "expression", "bc ns", "typed ns", "speedup");
+    for (size_t e = 0; e < sizeof(exprs) / sizeof(exprs[0]); ++e) {
+        Ast ast = {0};
+        Typed typed = {0};
+        Lexer lex = lexer(sv_from_cstr(exprs[e]), &vl);
+        parser(&ast, &lex);
+        typed_compile(&typed, &ast);
+
+        Value stack[typed.max_stack];
+        i64_t sum = 0;
+        // Modes take turns as in `bench_checked`
+        double times[2] = { 1e18, 1e18 };
+        for (int r = 0; r < TYPED_REPEATS; ++r) {
+            for (int mode = 0; mode < 2; ++mode) {
+                double start = now_ns();
+                for (size_t i = 0; i < TYPED_EVALS; ++i) {
+                    vl.items[0].val.i64 = (i64_t) i * 4096;
+                    vl.items[1].val.i64 = (i64_t) (i % 64);
+                    vl.items[2].val.f64 = (double) i * 0.5;
+
+                    Value v = mode == 0 ? bc_eval(&typed.prog, &vl, stack)
+                                        : typed_eval(&typed, &vl, stack);
+                    sum += v.i64;
+                }
+                double t = (now_ns() - start) / TYPED_EVALS;
+                if (t < times[mode]) times[mode] = t;
+            }
+        }
+
+        TABLE("%-48.48s %10.2f %10.2f %9.2fx\n", exprs[e], times[0], times[1], times[0] / times[1]);
+        record("typed", exprs[e], TYPED_EVALS, "bc_ns", times[0]);
+        record("typed", exprs[e], TYPED_EVALS, "typed_ns", times[1]);
+        if (sum == 42) fprintf(stderr, "unreachable\n");
+
+        typed_clean(&typed);
+        ast_clean(&ast);
+        lex_clean(&lex);
+    }
+
+    var_clean(&vl);
+    TABLE("\n------------------------------------------------------------\n\n");
+}
+
+#define IMAGE_EXPRS 100000
+#define IMAGE_PATH "bench.img"
+
+// Operand expressions of one "include file": cold run lexes, parses and
+// compiles all of them, warm run maps their image and only looks them up
+static void bench_image(void)
+{
+    TABLE("\n--------------------------- image --------------------------\n\n");
+
+    Var_List vl = {0};
+    for (size_t i = 0; i < 4; ++i) var_push(&vl, var_create((char *) shape_vars[i], VALUE_INT((i64_t) i + 1)));
+
+    char (*srcs)[96] = malloc(96 * IMAGE_EXPRS);
+    assert(srcs != NULL);
+    for (size_t i = 0; i < IMAGE_EXPRS; ++i) {
+        snprintf(srcs[i], 96, "%s + 4 * (%s - %zu) * %zu + %s", shape_vars[i % 4], shape_vars[(i / 4) % 4],
+                 i % 97, i % 13 + 1, shape_vars[(i / 16) % 4]);
+    }
+
+    Ast ast = {0};
+    Program prog = {0};
+    double start = now_ns();
+    for (size_t i = 0; i < IMAGE_EXPRS; ++i) {
+        Lexer lex = lexer_stream(sv_from_cstr(srcs[i]), &vl);
+        parser(&ast, &lex);
+        bc_compile(&prog, &ast);
+        ast_reset(&ast);
+    }
+    double cold = (now_ns() - start) / IMAGE_EXPRS;
+    ast_clean(&ast);
+    bc_clean(&prog);
+
+    Image_Writer w = {0};
+    start = now_ns();
+    for (size_t i = 0; i < IMAGE_EXPRS; ++i) image_add(&w, sv_from_cstr(srcs[i]), &vl);
+    int saved = image_save(&w, IMAGE_PATH);
+    double write = (now_ns() - start) / IMAGE_EXPRS;
+    image_writer_clean(&w);
+    assert(saved);
+
+    // Load and bind are once per run, find is once per operand
+    Image img = {0};
+    start = now_ns();
+    int loaded = image_load(&img, IMAGE_PATH);
+    image_bind(&img, &vl);
+    double load = now_ns() - start;
+    assert(loaded);
+
+    size_t *ids = malloc(sizeof(size_t) * IMAGE_EXPRS);
+    assert(ids != NULL);
+    start = now_ns();
+    for (size_t i = 0; i < IMAGE_EXPRS; ++i) ids[i] = image_find(&img, sv_from_cstr(srcs[i]));
+    double warm = (now_ns() - start + load) / IMAGE_EXPRS;
+
+    Value stack[16];
+    i64_t sum = 0;
+    start = now_ns();
+    for (size_t i = 0; i < IMAGE_EXPRS; ++i) sum += image_eval(&img, ids[i], &vl, stack).i64;
+    double eval = (now_ns() - start) / IMAGE_EXPRS;
+
+    TABLE("%10s %14s %14s %14s %14s %12s\n", "exprs", "cold ns", "write ns", "warm ns", "eval ns", "file bytes");
+    TABLE("%10d %14.2f %14.2f %14.2f %14.2f %12zu\n", IMAGE_EXPRS, cold, write, warm, eval, img.size);
+    TABLE("load + bind %.0f ns, speedup %.1fx (checksum %lld)\n", load, cold / warm, sum);
+    record("image", "exprs", IMAGE_EXPRS, "cold_ns", cold);
+    record("image", "exprs", IMAGE_EXPRS, "write_ns", write);
+    record("image", "exprs", IMAGE_EXPRS, "warm_ns", warm);
+    record("image", "exprs", IMAGE_EXPRS, "eval_ns", eval);
+    record("image", "exprs", IMAGE_EXPRS, "file_bytes", (double) img.size);
+
+    image_close(&img);
+    remove(IMAGE_PATH);
+    free(ids);
+    free(srcs);
+    var_clean(&vl);
+    TABLE("\n------------------------------------------------------------\n\n");
+}
+
+#define INCR_LABELS 1000
+#define INCR_EXPRS 200000
+#define INCR_ROUNDS 200
+
+// Second pass of an assembler: one label moves per round. Full pass
+// evaluates every operand, incremental one only operands of that label
+static void bench_incr(void)
+{
+    TABLE("\n--------------------------- incr ---------------------------\n\n");
+
+    Var_List vl = {0};
+    char name[16];
+    for (size_t i = 0; i < INCR_LABELS; ++i) {
+        var_name(name, i);
+        var_push(&vl, var_create(name, VALUE_INT((i64_t) i * 16)));
+    }
+
+    Program *progs = calloc(INCR_EXPRS, sizeof(Program));
+    assert(progs != NULL);
+    Incr inc = {0};
+    Ast ast = {0};
+    char src[64];
+    for (size_t i = 0; i < INCR_EXPRS; ++i) {
+        var_name(name, (i * 7919) % INCR_LABELS);
+        snprintf(src, sizeof(src), "%s + 4 * (%zu + 2)", name, i % 100);
+        Lexer lex = lexer_stream(sv_from_cstr(src), &vl);
+        parser(&ast, &lex);
+        bc_compile(&progs[i], &ast);
+        incr_add(&inc, &ast);
+        ast_reset(&ast);
+    }
+    ast_clean(&ast);
+
+    Value stack[8];
+    i64_t sum = 0;
+    double start = now_ns();
+    for (size_t r = 0; r < INCR_ROUNDS; ++r) {
+        var_name(name, r % INCR_LABELS);
+        var_push(&vl, var_create(name, VALUE_INT((i64_t) r)));
+        for (size_t i = 0; i < INCR_EXPRS; ++i) sum += bc_eval(&progs[i], &vl, stack).i64;
+    }
+    double full = (now_ns() - start) / INCR_ROUNDS;
+
+    size_t changed = 0;
+    incr_update(&inc);
+    start = now_ns();
+    for (size_t r = 0; r < INCR_ROUNDS; ++r) {
+        var_name(name, r % INCR_LABELS);
+        var_push(&vl, var_create(name, VALUE_INT((i64_t) r + 1)));
+        changed += incr_update(&inc)->count;
+    }
+    double incr = (now_ns() - start) / INCR_ROUNDS;
+
+    TABLE("%10s %10s %14s %14s %12s %10s\n", "exprs", "labels", "full us", "incr us", "changed", "speedup");
+    TABLE("%10d %10d %14.2f %14.2f %12.1f %9.1fx\n", INCR_EXPRS, INCR_LABELS, full / 1e3, incr / 1e3,
+          (double) changed / INCR_ROUNDS, full / incr);
+    TABLE("checksum %lld\n", sum);
+    record("incr", "exprs", INCR_EXPRS, "full_ns", full);
+    record("incr", "exprs", INCR_EXPRS, "incr_ns", incr);
+    record("incr", "exprs", INCR_EXPRS, "changed", (double) changed / INCR_ROUNDS);
+
+    for (size_t i = 0; i < INCR_EXPRS; ++i) bc_clean(&progs[i]);
+    free(progs);
+    incr_clean(&inc);
+    var_clean(&vl);
+    TABLE("\n------------------------------------------------------------\n\n");
+}
+
+#define IO_SIZE (64 << 20)
+#define IO_PATH "bench_io.txt"
+
+// Generated operand file is mapped and evaluated as `./eval` does it,
+// results go to /dev/null through Writer or by fprintf per result
+static void bench_io(void)
+{
+    TABLE("\n----------------------------- io ---------------------------\n\n");
+
+    Var_List vl = {0};
+    for (size_t i = 0; i < 4; ++i) var_push(&vl, var_create((char *) shape_vars[i], VALUE_INT((i64_t) i + 1)));
+
+    FILE *f = fopen(IO_PATH, "w");
+    assert(f != NULL);
+    size_t written = 0;
+    for (size_t i = 0; written < IO_SIZE; ++i) {
+        int n = fprintf(f, "%s + 4 * (%s - %zu)%c", shape_vars[i % 4], shape_vars[(i / 4) % 4], i % 1000,
+                        i % 3 == 2 ? '\n' : ',');
+        written += n;
+    }
+    fclose(f);
+
+    String_View input;
+    int mapped = io_map(IO_PATH, &input);
+    assert(mapped);
+
+    Ast ast = {0};
+    Writer w = { .fd = open("/dev/null", O_WRONLY) };
+    assert(w.fd >= 0);
+    double start = now_ns();
+    size_t count = io_eval(input, &vl, &ast, ARITH_WRAP, &w, NULL);
+    writer_flush(&w);
+    double buffered = now_ns() - start;
+    close(w.fd);
+    writer_clean(&w);
+
+    // Same loop, result is printed on its own
+    FILE *null = fopen("/dev/null", "w");
+    assert(null != NULL);
+    start = now_ns();
+    const char *p = input.data;
+    const char *end = input.data + input.count;
+    while (p < end) {
+        const char *q = p;
+        while (q < end && *q != '\n' && *q != ',') q++;
+        Lexer lex = lexer_stream((String_View) { .data = (char *) p, .count = q - p }, &vl);
+        p = q + 1;
+        if (lex.src.count == 0) continue;
+        parser(&ast, &lex);
+        fprintf(null, "%lld\n", ast_eval(&ast).i64);
+        ast_reset(&ast);
+    }
+    double printed = now_ns() - start;
+    fclose(null);
+
+    double mb = (double) input.count / (1 << 20);
+    TABLE("%10s %12s %14s %14s %14s\n", "MiB", "exprs", "writer MiB/s", "fprintf MiB/s", "writer ns");
+    TABLE("%10.1f %12zu %14.1f %14.1f %14.2f\n", mb, count, mb / (buffered / 1e9), mb / (printed / 1e9),
+          buffered / count);
+    record("io", "eval", count, "writer_mib_s", mb / (buffered / 1e9));
+    record("io", "eval", count, "fprintf_mib_s", mb / (printed / 1e9));
+
+    ast_clean(&ast);
+    io_unmap(input);
+    remove(IO_PATH);
+    var_clean(&vl);
+    TABLE("\n------------------------------------------------------------\n\n");
+}
+
+#define ERRORS_EXPRS 1000000
+#define ERRORS_LEN 32
+
+// Exiting `parser` against `expr_parse` on the same good expressions,
+// then `expr_parse` on a batch where every 100th one is bad
+static void bench_errors(void)
+{
+    TABLE("\n--------------------------- errors -------------------------\n\n");
+
+    Var_List vl = {0};
+    for (size_t i = 0; i < 4; ++i) var_push(&vl, var_create((char *) shape_vars[i], VALUE_INT((i64_t) i + 1)));
+
+    static const char *bad[] = { "%s + $", "(%s + 1", "%s + bob", "%s 4", "%s + 99999999999999999999" };
+    char *good = malloc(ERRORS_EXPRS * ERRORS_LEN);
+    char *mixed = malloc(ERRORS_EXPRS * ERRORS_LEN);
+    assert(good != NULL && mixed != NULL);
+    for (size_t i = 0; i < ERRORS_EXPRS; ++i) {
+        const char *var = shape_vars[i % 4];
+        snprintf(good + i * ERRORS_LEN, ERRORS_LEN, "%s + 4 * (%s - %zu)", var, var, i % 1000);
+        if (i % 100 == 99) snprintf(mixed + i * ERRORS_LEN, ERRORS_LEN, bad[(i / 100) % 5], var);
+        else memcpy(mixed + i * ERRORS_LEN, good + i * ERRORS_LEN, ERRORS_LEN);
+    }
+
+    Ast ast = {0};
+    i64_t sum = 0;
+    double start = now_ns();
+    for (size_t i = 0; i < ERRORS_EXPRS; ++i) {
+        Lexer lex = lexer_stream(sv_from_cstr(good + i * ERRORS_LEN), &vl);
+        parser(&ast, &lex);
+        sum += ast_eval(&ast).i64;
+        ast_reset(&ast);
+    }
+    double exiting = now_ns() - start;
+
+    Expr_Error err;
+    start = now_ns();
+    for (size_t i = 0; i < ERRORS_EXPRS; ++i) {
+        if (expr_parse(&ast, sv_from_cstr(good + i * ERRORS_LEN), &vl, &err) != EXPR_OK) continue;
+        sum += ast_eval(&ast).i64;
+        ast_reset(&ast);
+    }
+    double recoverable = now_ns() - start;
+
+    size_t failed = 0;
+    start = now_ns();
+    for (size_t i = 0; i < ERRORS_EXPRS; ++i) {
+        if (expr_parse(&ast, sv_from_cstr(mixed + i * ERRORS_LEN), &vl, &err) != EXPR_OK) {
+            failed += 1;
+            continue;
+        }
+        sum += ast_eval(&ast).i64;
+        ast_reset(&ast);
+    }
+    double with_bad = now_ns() - start;
+
+    TABLE("%10s %10s %14s %14s %14s\n", "exprs", "failed", "parser ns", "try ns", "try 1% bad ns");
+    TABLE("%10d %10zu %14.2f %14.2f %14.2f\n", ERRORS_EXPRS, failed, exiting / ERRORS_EXPRS,
+          recoverable / ERRORS_EXPRS, with_bad / ERRORS_EXPRS);
+    TABLE("checksum %lld\n", sum);
+    record("errors", "exprs", ERRORS_EXPRS, "parser_ns", exiting / ERRORS_EXPRS);
+    record("errors", "exprs", ERRORS_EXPRS, "try_ns", recoverable / ERRORS_EXPRS);
+    record("errors", "exprs", ERRORS_EXPRS, "try_bad_ns", with_bad / ERRORS_EXPRS);
+
+    ast_clean(&ast);
+    free(good);
+    free(mixed);
+    var_clean(&vl);
+    TABLE("\n------------------------------------------------------------\n\n");
+}
+
+typedef struct {
+    const char *name;
+    void (*run)(void);
+} Suite;
+
+static const Suite suites[] = {
+    { "var_search", bench_var_search },
+    { "number",     bench_number },
+    { "lexer",      bench_lexer },
+    { "phases",     bench_phases },
+    { "batch",      bench_batch },
+    { "pipeline",   bench_pipeline },
+    { "cache",      bench_cache },
+    { "dag",        bench_dag },
+    { "jit",        bench_jit },
+    { "checked",    bench_checked },
+    { "typed",      bench_typed },
+    { "image",      bench_image },
+    { "incr",       bench_incr },
+    { "io",         bench_io },
+    { "errors",     bench_errors },
+};
+
+#define SUITES_COUNT (sizeof(suites) / sizeof(suites[0]))
+
+// Usage: ./bench [--csv] [suite...], all suites are run if none is given
+int main(int argc, char **argv)
+{
+    int selected[SUITES_COUNT] = {0};
+    int any = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--csv") == 0) {
+            bench_csv = 1;
+            continue;
+        }
+
+        size_t k = 0;
+        while (k < SUITES_COUNT && strcmp(argv[i], suites[k].name) != 0) k++;
+        if (k == SUITES_COUNT) {
+            fprintf(stderr, "Error: unknown suite `%s`\n", argv[i]);
+            return 1;
+        }
+        selected[k] = 1;
+        any = 1;
+    }
+
+    if (bench_csv) printf("suite,case,size,metric,value\n");
+    for (size_t k = 0; k < SUITES_COUNT; ++k) {
+        if (!any || selected[k]) suites[k].run();
+    }
+    return 0;
+}
@@ -0,0 +1,45 @@
+// Answers of expr.hpp are checked by the compiler against answers of test.c
+
+#include <cstdio>
+
+#include "../include/expr.hpp"
+
+using expr::Value;
+
+static_assert(expr::eval("4 * (((32 + 4 + 1) * (5 + 3 + 6) * (2 + 3 + 5 + 6)) + ((9 * (2 + 3 - 4) * 3 + (5 + 6 - 3)) * 2) * ((3 * 3 * 3) - (4 - 5) * 3 * 3))").i64() == 43232);
+static_assert(expr::eval("((2 * (1 + 3 + 4 - 6) * (23 - 2) * 3 + (34 + 4) * (6 * 7 - 2 * (3 + 1 - 2) * 2 * 4) * (3 * (3 -  45) + 5 * (34 + 45) * (434 - 2)) + (3 - 5)) + ( 3 * ( 5 * ( 4 * (34 + 6) - 54) - 45) * 4))").i64() == 64801390);
+static_assert(expr::eval("98721354+2355467*1654567+23445467*(2345467-2384567)+38676*8534567-3453456+(3454565*54675345)*(3400-645)").i64() == 520366424704182654);
+static_assert(expr::eval("9223372036854775807 - 9223372036854775000 + 4000000000 * 2").i64() == 8000000807);
+static_assert(expr::eval("3.5 * (2.25 + 1.0) - 10.0 / 4.0 + 0.1").f64() == 3.5 * (2.25 + 1.0) - 10.0 / 4.0 + 0.1);
+static_assert(expr::eval("7 / 2 - 1").type == expr::Type::Int);
+
+#define TEST0 "23 * (32 * (arsenii*(4 * (45 + arsenii* (1234 - 3434 * (arsenii - 1))) + 3 * (234 + 5) + 2 * (32 + 4)) + 56) + 4 * (45 + 1) + arsenii * (234 + 5) + 2 * (32 + 4))"
+
+static_assert(expr::eval(TEST0, {{ "arsenii", Value::from_int(3) }}).i64() == -147075317);
+static_assert(expr::eval(TEST0, {{ "arsenii", Value::from_int(4) }}).i64() == -424217244);
+static_assert(expr::compile("a * b + a").var_count == 2);
+
+int main(void)
+{
+    constexpr auto test0 = expr::compile(TEST0);
+    Value arsenii = Value::from_int(3);
+    printf("Test0 (C++17 program): %lld\n", test0.eval(&arsenii).i64());
+
+#if __cplusplus >= 202002L
+    using Test0 = expr::Expr<TEST0>;
+    using Float = expr::Expr<"x * x + x">;
+    static_assert(Test0::eval(Value::from_int(4)).i64() == -424217244);
+    static_assert(expr::Expr<"1 + 2 * 3">::value().i64() == 7);
+
+    printf("Test0 (C++20 type): %lld\n", Test0::eval(arsenii).i64());
+    printf("x * x + x, x = 4.0: %lf\n", Float::eval(Value::from_float(4.0)).f64());
+#endif
+
+    try {
+        expr::eval("1 + (2 * 3");
+    } catch (const expr::Error &e) {
+        printf("Error at %zu: %s\n", e.pos, e.what());
+    }
+
+    return 0;
+}
@@ -1,4 +1,15 @@
 #include "../include/parser.h"
+#include "../include/flat.h"
+#include "../include/batch.h"
+#include "../include/pipeline.h"
+#include "../include/cache.h"
+#include "../include/dag.h"
+#include "../include/jit.h"
+#include "../include/image.h"
+#include "../include/incr.h"
+#include "../include/io.h"
+#include "../include/checked.h"
+#include "../include/typed.h"
 
 int main(void)
 {
@@ -10,29 +21,400 @@ int main(void)
         "23 * (32 * (arsenii*(4 * (45 + arsenii* (1234 - 3434 * (arsenii - 1))) + 3 * (234 + 5) + 2 * (32 + 4)) + 56) + 4 * (45 + 1) + arsenii * (234 + 5) + 2 * (32 + 4))",
         "4 * (((32 + 4 + 1) * (5 + 3 + 6) * (2 + 3 + 5 + 6)) + ((9 * (2 + 3 - 4) * 3 + (5 + 6 - 3)) * 2) * ((3 * 3 * 3) - (4 - 5) * 3 * 3))",
         "((2 * (1 + 3 + 4 - 6) * (23 - 2) * 3 + (34 + 4) * (6 * 7 - 2 * (3 + 1 - 2) * 2 * 4) * (3 * (3 -  45) + 5 * (34 + 45) * (434 - 2)) + (3 - 5)) + ( 3 * ( 5 * ( 4 * (34 + 6) - 54) - 45) * 4))",
-        "98721354+2355467*1654567+23445467*(2345467-2384567)+38676*8534567-3453456+(3454565*54675345)*(3400-645)"
+        "98721354+2355467*1654567+23445467*(2345467-2384567)+38676*8534567-3453456+(3454565*54675345)*(3400-645)",
+        "9223372036854775807 - 9223372036854775000 + 4000000000 * 2",
+        "3.5 * (2.25 + 1.0) - 10.0 / 4.0 + 0.1"
     };
 
+    Ast ast = {0};
+    Flat_Ast fa = {0};
+    Program prog = {0};
+    Jit jit = {0};
     for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i) {
-        Ast ast = {0};
-
         printf("\n\n--------------------------- Test%zu ---------------------------\n\n", i);
         Lexer lex = lexer(sv_from_cstr(tests[i]), &vl);
         print_lex(&lex);
 
         parser(&ast, &lex);
         print_ast(&ast);
+
+        bc_compile(&prog, &ast);
+        jit_compile(&jit, &ast);
+        flat_compile(&fa, &ast);
+        Value value = ast_eval(&ast);
         
         eval(&ast);
 
         printf("Answer:\n\t");
         print_node(ast.root);
+
+        printf("Non-destructive answer:\n\t");
+        print_token((Token) { .type = TYPE_VALUE, .val = value });
+
+        printf("Flat answer:\n\t");
+        print_token((Token) { .type = TYPE_VALUE, .val = flat_eval(&fa) });
+
+        Value stack[prog.max_stack];
+        printf("Bytecode answer:\n\t");
+        print_token((Token) { .type = TYPE_VALUE, .val = bc_eval(&prog, &vl, stack) });
+
+        printf("JIT answer:\n\t");
+        print_token((Token) { .type = TYPE_VALUE, .val = jit_eval(&jit, &vl, stack) });
+
+        // Variables are bound late, so compiled program sees new value
+        var_push(&vl, var_create("arsenii", VALUE_INT(4)));
+        printf("Bytecode answer (arsenii = 4):\n\t");
+        print_token((Token) { .type = TYPE_VALUE, .val = bc_eval(&prog, &vl, stack) });
+        printf("JIT answer (arsenii = 4):\n\t");
+        print_token((Token) { .type = TYPE_VALUE, .val = jit_eval(&jit, &vl, stack) });
+
+        var_push(&vl, arsenii);
+
+        // Same expression parsed straight from the source, without token array
+        ast_reset(&ast);
+        Lexer stream = lexer_stream(sv_from_cstr(tests[i]), &vl);
+        parser(&ast, &stream);
+        printf("Stream answer:\n\t");
+        print_token((Token) { .type = TYPE_VALUE, .val = ast_eval(&ast) });
         printf("\n\n--------------------------- Test%zuEnd ------------------------------\n\n",i);
         
-        ast_clean(ast.root, &ast.count);
+        ast_reset(&ast);
         lex_clean(&lex);
     }
     
+    printf("\n\n---------------------------- JIT ----------------------------\n\n");
+    {
+        var_push(&vl, var_create("arsenii", VALUE_FLOAT(4.0)));
+        Lexer lex = lexer(sv_from_cstr("arsenii * arsenii + arsenii"), &vl);
+        parser(&ast, &lex);
+        printf("native code: %s\n", jit_compile(&jit, &ast) ? "yes" : "no");
+
+        Value stack[jit.prog.max_stack];
+        printf("arsenii = 4.0: ");
+        print_token((Token) { .type = TYPE_VALUE, .val = jit_eval(&jit, &vl, stack) });
+
+        // Compiled for f64 `arsenii`, int value goes through the bytecode fallback
+        var_push(&vl, arsenii);
+        printf("arsenii = 3 (fallback): ");
+        print_token((Token) { .type = TYPE_VALUE, .val = jit_eval(&jit, &vl, stack) });
+
+        ast_reset(&ast);
+        lex_clean(&lex);
+    }
+
+    printf("\n\n--------------------------- Batch ---------------------------\n\n");
+    Lexer lex = lexer(sv_from_cstr(tests[0]), &vl);
+    parser(&ast, &lex);
+    bc_compile(&prog, &ast);
+
+    // Test0 for arsenii = 0..9
+    i64_t xs[10];
+    i64_t out[10];
+    Column cols[1];
+    for (size_t i = 0; i < 10; ++i) xs[i] = (i64_t) i;
+    cols[var_find(&vl, arsenii.name)] = (Column) { .type = VAL_INT, .data = xs };
+
+    Batch_Scratch scratch = {0};
+    bc_eval_batch(&prog, cols, 10, out, &scratch);
+    // Empty program returns before touching scratch or output
+    printf("empty program: %s\n", bc_eval_batch(&(Program) {0}, cols, 10, out, &scratch) == VAL_INT ? "int" : "float");
+    batch_clean(&scratch);
+
+    Value stack[prog.max_stack];
+    for (size_t i = 0; i < 10; ++i) {
+        var_push(&vl, var_create("arsenii", VALUE_INT(xs[i])));
+        printf("arsenii = %lld: batch `%lld` bytecode `%lld`\n", xs[i], out[i], bc_eval(&prog, &vl, stack).i64);
+    }
+    ast_reset(&ast);
+    lex_clean(&lex);
+    var_push(&vl, arsenii);
+
+    printf("\n\n-------------------------- Pipeline -------------------------\n\n");
+    size_t n = sizeof(tests) / sizeof(tests[0]);
+    String_View exprs[n + 1];
+    Value results[n + 1];
+    Expr_Status status[n + 1];
+    for (size_t i = 0; i < n; ++i) exprs[i] = sv_from_cstr(tests[i]);
+    exprs[n] = sv_from_cstr("2 * (3 + ");
+
+    // Bad expression gets its status and the rest are still evaluated
+    pipeline_eval(exprs, n + 1, &vl, results, status, 4);
+    for (size_t i = 0; i < n; ++i) {
+        printf("Test%zu: ", i);
+        print_token((Token) { .type = TYPE_VALUE, .val = results[i] });
+    }
+    printf("`2 * (3 + `: %s\n", expr_status_name(status[n]));
+
+    printf("\n\n--------------------------- Cache ---------------------------\n\n");
+    // Small capacity, so the last expressions evict earlier ones
+    Cache cache = { .capacity = 3 };
+    char *cached[] = {
+        "arsenii + 4 * 2", "arsenii+4*2", " arsenii +  4*2 ", "3 * (2 + 1)", "3*(2+1)",
+        "arsenii", "arsenii * arsenii", "arsenii + 4 * 2", "3 * (2 + 1)",
+    };
+    for (size_t i = 0; i < sizeof(cached) / sizeof(cached[0]); ++i) {
+        if (i == 5) var_push(&vl, var_create("arsenii", VALUE_INT(10)));
+        printf("`%s` = ", cached[i]);
+        print_token((Token) { .type = TYPE_VALUE, .val = cache_eval(&cache, sv_from_cstr(cached[i]), &vl) });
+    }
+    printf("hits %zu, misses %zu, value hits %zu, evictions %zu\n",
+           cache.hits, cache.misses, cache.value_hits, cache.evictions);
+    cache_clean(&cache);
+    var_push(&vl, arsenii);
+
+    printf("\n\n---------------------------- DAG ----------------------------\n\n");
+    // All tests share one node table, equal subtrees become one node
+    Dag dag = {0};
+    uint32_t roots[n];
+    size_t tree_nodes = 0;
+    for (size_t i = 0; i < n; ++i) {
+        Lexer stream = lexer_stream(exprs[i], &vl);
+        parser(&ast, &stream);
+        tree_nodes += ast.count;
+        roots[i] = dag_add(&dag, &ast);
+        ast_reset(&ast);
+    }
+    printf("tree nodes %zu, dag nodes %zu\n", tree_nodes, dag.count);
+
+    for (size_t i = 0; i < n; ++i) {
+        printf("Test%zu: ", i);
+        print_token((Token) { .type = TYPE_VALUE, .val = dag_eval(&dag, roots[i]) });
+    }
+    printf("evaluated %zu nodes\n", dag.evaluated);
+
+    // Pushing a variable starts new epoch, Test0 is computed again
+    var_push(&vl, var_create("arsenii", VALUE_INT(4)));
+    printf("Test0 (arsenii = 4): ");
+    print_token((Token) { .type = TYPE_VALUE, .val = dag_eval(&dag, roots[0]) });
+    printf("Test0 again: ");
+    print_token((Token) { .type = TYPE_VALUE, .val = dag_eval(&dag, roots[0]) });
+    printf("evaluated %zu nodes\n", dag.evaluated);
+    var_push(&vl, arsenii);
+    dag_clean(&dag);
+
+    printf("\n\n--------------------------- Image ---------------------------\n\n");
+    // Cold run compiles tests into the file, warm run maps it and skips lexer and parser
+    Image_Writer writer = {0};
+    for (size_t i = 0; i < n; ++i) image_add(&writer, exprs[i], &vl);
+    image_add(&writer, sv_from_cstr(" arsenii+1 "), &vl);
+    printf("saved: %s\n", image_save(&writer, "test.img") ? "yes" : "no");
+    image_writer_clean(&writer);
+
+    Image img = {0};
+    printf("loaded: %s\n", image_load(&img, "test.img") ? "yes" : "no");
+    printf("found before bind: %s\n", image_find(&img, exprs[0]) != IMAGE_NOT_FOUND ? "yes" : "no");
+    printf("exprs %llu, symbols %llu, unbound %zu\n", (unsigned long long) img.header->expr_count,
+           (unsigned long long) img.header->sym_count, image_bind(&img, &vl));
+    for (size_t i = 0; i < n; ++i) {
+        size_t id = image_find(&img, exprs[i]);
+        Value stack[img.exprs[id].max_stack];
+        printf("Test%zu: ", i);
+        print_token((Token) { .type = TYPE_VALUE, .val = image_eval(&img, id, &vl, stack) });
+    }
+    size_t id = image_find(&img, sv_from_cstr("arsenii + 1"));
+    Value image_stack[img.exprs[id].max_stack];
+    printf("`arsenii + 1` = ");
+    print_token((Token) { .type = TYPE_VALUE, .val = image_eval(&img, id, &vl, image_stack) });
+    printf("`2 + 2` found: %s\n", image_find(&img, sv_from_cstr("2 + 2")) != IMAGE_NOT_FOUND ? "yes" : "no");
+    // Loading over a loaded image closes the old one, so it is not bound again
+    printf("loaded again: %s\n", image_load(&img, "test.img") ? "yes" : "no");
+    printf("found before bind: %s\n", image_find(&img, exprs[0]) != IMAGE_NOT_FOUND ? "yes" : "no");
+    image_close(&img);
+    remove("test.img");
+
+    printf("\n\n------------------------ Incremental ------------------------\n\n");
+    // Only expressions which read `arsenii` are computed again
+    Incr inc = {0};
+    char *operands[] = { "arsenii * 8 + 4", "16 * 4", "(arsenii - 3) * 100", "arsenii / 4" };
+    size_t m = sizeof(operands) / sizeof(operands[0]);
+    for (size_t i = 0; i < n + m; ++i) {
+        Lexer stream = lexer_stream(i < n ? exprs[i] : sv_from_cstr(operands[i - n]), &vl);
+        parser(&ast, &stream);
+        incr_add(&inc, &ast);
+        ast_reset(&ast);
+    }
+    incr_update(&inc);
+    printf("nothing pushed: %zu of %zu nodes computed again\n", inc.recomputed, inc.count);
+
+    for (i64_t x = 4; x <= 5; ++x) {
+        var_push(&vl, var_create("arsenii", VALUE_INT(x)));
+        const Index_Stack *changed = incr_update(&inc);
+        printf("arsenii = %lld: %zu of %zu nodes computed again, changed:\n", x, inc.recomputed, inc.count);
+        for (size_t i = 0; i < changed->count; ++i) {
+            size_t e = changed->items[i];
+            if (e < n) printf("\tTest%zu: ", e);
+            else printf("\t%s: ", operands[e - n]);
+            print_token((Token) { .type = TYPE_VALUE, .val = incr_value(&inc, e) });
+        }
+        inc.recomputed = 0;
+    }
+    var_push(&vl, arsenii);
+    incr_clean(&inc);
+
+    printf("\n\n----------------------------- IO ----------------------------\n\n");
+    // Same loop as `./eval` runs over a mapped file, results go through one buffer
+    {
+        char input[] = "1 + 2, arsenii * 3\n\n  4.0 / 8.0 ,\r\n7 - , 7 - 10\n1/0, 2 + 4 / (arsenii - 3)\n";
+        Writer w = { .fd = fileno(stdout) };
+        fflush(stdout);
+        size_t failed = 0;
+        size_t count = io_eval(sv_from_cstr(input), &vl, &ast, ARITH_WRAP, &w, &failed);
+        writer_flush(&w);
+        writer_clean(&w);
+        printf("%zu expressions, %zu failed\n", count, failed);
+    }
+
+    printf("\n\n--------------------------- Errors --------------------------\n\n");
+    // Every bad expression is reported and the same ast parses the next one
+    {
+        char *bad[] = {
+            "1 + 99999999999999999999", "2 * $", "2 ^ 3", "arsenii + bob",
+            "(1 + 2", "1 + 2)", "1 +", "* 3", "4 4",
+        };
+        Expr_Error err;
+        for (size_t i = 0; i < sizeof(bad) / sizeof(*bad); ++i) {
+            Expr_Status status = expr_parse(&ast, sv_from_cstr(bad[i]), &vl, &err);
+            printf("%-26s %-8s at %zu: %s\n", bad[i], expr_status_name(status), err.pos, err.message);
+        }
+
+        Lexer lex = lexer_try(sv_from_cstr("arsenii * 2 $ 1"), &vl, &err);
+        printf("%-26s %-8s at %zu: %s\n", "arsenii * 2 $ 1", expr_status_name(parser_try(&ast, &lex, &err)),
+               err.pos, err.message);
+        lex_clean(&lex);
+
+        expr_parse(&ast, sv_from_cstr("arsenii * 2"), &vl, &err);
+        printf("%-26s ", "arsenii * 2");
+        print_token((Token) { .type = TYPE_VALUE, .val = ast_eval(&ast) });
+        ast_reset(&ast);
+    }
+
+    printf("\n\n-------------------------- Checked --------------------------\n\n");
+    // Each overflow policy on the same programs, arsenii = 3
+    {
+        char *checked[] = {
+            "9223372036854775807 + arsenii",
+            "0 - 9223372036854775807 - arsenii",
+            "4611686018427387904 * arsenii / 6",
+            "(0 - 9223372036854775807 - 1) / (0 - 1)",
+            "1 / (arsenii - 3)",
+            tests[4],
+        };
+        for (size_t i = 0; i < sizeof(checked) / sizeof(*checked); ++i) {
+            Lexer lex = lexer(sv_from_cstr(checked[i]), &vl);
+            parser(&ast, &lex);
+            bc_compile(&prog, &ast);
+            ast_reset(&ast);
+            lex_clean(&lex);
+
+            Value stack[prog.max_stack];
+            printf("%s\n", checked[i]);
+            for (Arith_Policy p = 0; p < ARITH_POLICY_COUNT; ++p) {
+                Arith_Status status;
+                Value res = bc_eval_checked(&prog, &vl, stack, p, &status);
+                printf("\t%-9s %-17s %lld\n", arith_policy_name(p), arith_status_name(status), res.i64);
+            }
+        }
+    }
+
+    printf("\n\n--------------------------- Types ---------------------------\n\n");
+    // Mixed expressions by every evaluator, typed program has explicit conversions
+    {
+        char *mixed[] = {
+            "arsenii * 2.5 + 1",
+            "(arsenii + 1) / 2.0",
+            "7 / 2 * 1.0",
+            "1.5 + arsenii / 2",
+        };
+        Typed typed = {0};
+        for (size_t i = 0; i < sizeof(mixed) / sizeof(*mixed); ++i) {
+            Lexer lex = lexer(sv_from_cstr(mixed[i]), &vl);
+            parser(&ast, &lex);
+            typed_compile(&typed, &ast);
+            jit_compile(&jit, &ast);
+            if (i == 0) print_typed(&typed);
+
+            Value stack[typed.max_stack];
+            printf("%s\n\ttree:  ", mixed[i]);
+            print_token((Token) { .type = TYPE_VALUE, .val = ast_eval(&ast) });
+            printf("\ttyped: ");
+            print_token((Token) { .type = TYPE_VALUE, .val = typed_eval(&typed, &vl, stack) });
+            printf("\tjit:   ");
+            print_token((Token) { .type = TYPE_VALUE, .val = jit_eval(&jit, &vl, stack) });
+
+            // Guard fails, bytecode gives the same result as a new compile would
+            var_push(&vl, var_create("arsenii", VALUE_FLOAT(3.5)));
+            printf("\tarsenii = 3.5: ");
+            print_token((Token) { .type = TYPE_VALUE, .val = typed_eval(&typed, &vl, stack) });
+            var_push(&vl, arsenii);
+
+            ast_reset(&ast);
+            lex_clean(&lex);
+        }
+        typed_clean(&typed);
+    }
+
+    printf("\n\n---------------------------- Deep ---------------------------\n\n");
+    // Million terms as left deep chain and as right deep nesting
+    size_t terms = 1000000;
+    char *chain = malloc(terms * 4 + 8);
+    char *nested = malloc(terms * 6);
+    assert(chain != NULL && nested != NULL);
+
+    char *p = chain + sprintf(chain, "arsenii");
+    for (size_t i = 1; i < terms; ++i, p += 4) memcpy(p, " + 1", 4);
+    *p = '\0';
+
+    p = nested;
+    for (size_t i = 1; i < terms; ++i, p += 5) memcpy(p, "1 + (", 5);
+    *p++ = '1';
+    memset(p, ')', terms - 1);
+    p[terms - 1] = '\0';
+
+    char *deep[] = { chain, nested };
+    for (size_t i = 0; i < sizeof(deep) / sizeof(deep[0]); ++i) {
+        Lexer stream = lexer_stream(sv_from_cstr(deep[i]), &vl);
+        parser(&ast, &stream);
+        bc_compile(&prog, &ast);
+        printf("Deep%zu (%zu nodes):\n", i, ast.count);
+
+        printf("Non-destructive answer:\n\t");
+        print_token((Token) { .type = TYPE_VALUE, .val = ast_eval(&ast) });
+
+        Value *big = malloc(sizeof(Value) * prog.max_stack);
+        assert(big != NULL);
+        printf("Bytecode answer:\n\t");
+        print_token((Token) { .type = TYPE_VALUE, .val = bc_eval(&prog, &vl, big) });
+        free(big);
+
+        eval(&ast);
+        printf("Answer:\n\t");
+        print_node(ast.root);
+
+        ast_reset(&ast);
+        lex_clean(&stream);
+    }
+    free(chain);
+    free(nested);
+
+    // Hash is computed by `var_push`, so a variable made without `var_create` is found too
+    var_push(&vl, (Variable) { .name = sv_from_cstr("nohash"), .val = VALUE_INT(7) });
+    printf("\n`nohash` found: %s\n", var_find(&vl, sv_from_cstr("nohash")) != VAR_NOT_FOUND ? "yes" : "no");
+
+    // Nothing is parsed yet, so there is no first value to return
+    Ast empty = {0};
+    printf("empty tree: ");
+    print_token((Token) { .type = TYPE_VALUE, .val = ast_eval(&empty) });
+    ast_clean(&empty);
+
+#ifdef STATS_ENABLE
+    printf("\n\n--------------------------- Stats ---------------------------\n\n");
+    stats_dump_json(stdout);
+#endif
+
+    ast_clean(&ast);
+    flat_clean(&fa);
+    bc_clean(&prog);
+    jit_clean(&jit);
     var_clean(&vl);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,106 @@
+// Evaluates every expression of a file, one result per line to stdout
+//
+// Usage: ./eval [-p wrap|trap|saturate|promote] [-D name=value]... <file>
+//
+// Expressions are separated by newlines or commas. Bad ones print
+// `error: ...` in place of the result and make exit code 1. Integer
+// overflow follows the policy of `-p`, `wrap` if it is not given
+
+#include <unistd.h>
+
+#include "../include/io.h"
+
+static void usage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [-p wrap|trap|saturate|promote] [-D name=value]... <file>\n", program);
+}
+
+// `name=value`, value is a number literal with optional `-`
+static Variable eval_define(char *arg)
+{
+    char *eq = strchr(arg, '=');
+    if (eq == NULL) {
+        fprintf(stderr, "Error: expected `name=value`, got `%s`\n", arg);
+        EXIT;
+    }
+    *eq = '\0';
+
+    String_View name = sv_from_cstr(arg);
+    if (name.count == 0 || sv_span_alpha(name.data, name.count) != name.count) {
+        fprintf(stderr, "Error: variable name `%s` must contain only letters\n", arg);
+        EXIT;
+    }
+
+    String_View value = sv_trim(sv_from_cstr(eq + 1));
+    int negative = value.count > 0 && value.data[0] == '-';
+    if (negative) sv_cut_left(&value, 1);
+
+    Value val = tokenise_value(value);
+    if (negative && val.type == VAL_FLOAT) val.f64 = -val.f64;
+    if (negative && val.type == VAL_INT) val.i64 = -val.i64;
+
+    return var_create(arg, val);
+}
+
+static Arith_Policy eval_policy(const char *arg)
+{
+    for (Arith_Policy p = 0; p < ARITH_POLICY_COUNT; ++p) {
+        if (strcmp(arg, arith_policy_name(p)) == 0) return p;
+    }
+    fprintf(stderr, "Error: unknown policy `%s`, expected wrap, trap, saturate or promote\n", arg);
+    EXIT;
+}
+
+int main(int argc, char **argv)
+{
+    Var_List vl = {0};
+    const char *path = NULL;
+    Arith_Policy policy = ARITH_WRAP;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            policy = eval_policy(argv[++i]);
+        } else if (strcmp(argv[i], "-D") == 0 && i + 1 < argc) {
+            var_push(&vl, eval_define(argv[++i]));
+        } else if (strncmp(argv[i], "-D", 2) == 0 && argv[i][2] != '\0') {
+            var_push(&vl, eval_define(argv[i] + 2));
+        } else if (path == NULL && argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (path == NULL) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    String_View input;
+    if (!io_map(path, &input)) {
+        fprintf(stderr, "Error: cannot map `%s`\n", path);
+        return 1;
+    }
+
+    Writer w = { .fd = STDOUT_FILENO };
+    Ast ast = {0};
+    size_t failed = 0;
+    io_eval(input, &vl, &ast, policy, &w, &failed);
+    int ok = writer_flush(&w);
+
+    writer_clean(&w);
+    ast_clean(&ast);
+    io_unmap(input);
+    var_clean(&vl);
+
+    if (!ok) {
+        fprintf(stderr, "Error: cannot write output\n");
+        return 1;
+    }
+    if (failed > 0) {
+        fprintf(stderr, "Error: %zu expressions failed\n", failed);
+        return 1;
+    }
+    return 0;
+}